@@ -1,8 +1,26 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#ifdef __cpp_impl_three_way_comparison
+#include <compare>
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BIGINTEGER_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
 size_t count_digits(uint64_t value) {
   size_t count = 0;
   while (value != 0) {
@@ -12,7 +30,361 @@ size_t count_digits(uint64_t value) {
   return count;
 }
 
+uint64_t read_digits(const char* begin, size_t count) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < count; ++i) {
+    value = value * 10 + (begin[i] - '0');
+  }
+  return value;
+}
+
+// Writes exactly `count` digits of `value`, zero-padded on the left.
+void write_digits(char* begin, uint64_t value, size_t count) {
+  for (size_t i = count; i != 0; --i) {
+    begin[i - 1] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  }
+}
+
+// Thread-local free lists of limb buffers in power-of-two size classes, so
+// that the temporaries of a hot loop keep reusing the same few buffers. At
+// most cache_limit() limbs are kept per thread; larger surpluses go back to
+// the heap. The counters cover every thread: the workers of a threaded
+// multiplication start with empty pools, so their buffers come from the
+// heap and show up in stats().
+class LimbPool {
+ public:
+  struct Stats {
+    uint64_t heap_allocations = 0;
+    uint64_t heap_releases = 0;
+    uint64_t pool_hits = 0;
+  };
+  // Returns a buffer of at least `capacity` limbs and sets `capacity` to its
+  // actual size.
+  static uint64_t* allocate(size_t& capacity) {
+    size_t size_class = capacity <= 1 ? 0 : 64 - __builtin_clzll(capacity - 1);
+    capacity = size_t(1) << size_class;
+    if (!closed_) {
+      LimbPool& pool = local();
+      std::vector<uint64_t*>& list = pool.free_[size_class];
+      if (!list.empty()) {
+        uint64_t* data = list.back();
+        list.pop_back();
+        pool.cached_limbs_ -= capacity;
+        count(counters_.pool_hits);
+        return data;
+      }
+    }
+    count(counters_.heap_allocations);
+    return new uint64_t[capacity];
+  }
+  // `data` must come from allocate() with the `capacity` it returned.
+  static void release(uint64_t* data, size_t capacity) {
+    if (!closed_) {
+      LimbPool& pool = local();
+      if (pool.cached_limbs_ + capacity <= pool.cache_limit_) {
+        pool.free_[__builtin_ctzll(capacity)].push_back(data);
+        pool.cached_limbs_ += capacity;
+        return;
+      }
+    }
+    count(counters_.heap_releases);
+    delete[] data;
+  }
+  static Stats stats() {
+    Stats result;
+    result.heap_allocations =
+        counters_.heap_allocations.load(std::memory_order_relaxed);
+    result.heap_releases =
+        counters_.heap_releases.load(std::memory_order_relaxed);
+    result.pool_hits = counters_.pool_hits.load(std::memory_order_relaxed);
+    return result;
+  }
+  static void reset_stats() {
+    counters_.heap_allocations.store(0, std::memory_order_relaxed);
+    counters_.heap_releases.store(0, std::memory_order_relaxed);
+    counters_.pool_hits.store(0, std::memory_order_relaxed);
+  }
+  static size_t cache_limit() { return local().cache_limit_; }
+  static void set_cache_limit(size_t limbs) {
+    local().cache_limit_ = limbs;
+    trim();
+  }
+  // Returns the buffers cached by this thread beyond cache_limit() to the
+  // heap; set_cache_limit(0) empties the pool.
+  static void trim() {
+    LimbPool& pool = local();
+    for (size_t size_class = pool.free_.size(); size_class != 0;
+         --size_class) {
+      std::vector<uint64_t*>& list = pool.free_[size_class - 1];
+      while (!list.empty() && pool.cached_limbs_ > pool.cache_limit_) {
+        delete[] list.back();
+        list.pop_back();
+        pool.cached_limbs_ -= size_t(1) << (size_class - 1);
+        count(counters_.heap_releases);
+      }
+    }
+  }
+
+ private:
+  struct Counters {
+    std::atomic<uint64_t> heap_allocations{0};
+    std::atomic<uint64_t> heap_releases{0};
+    std::atomic<uint64_t> pool_hits{0};
+  };
+  LimbPool() = default;
+  ~LimbPool() {
+    cache_limit_ = 0;
+    trim();
+    closed_ = true;
+  }
+  static LimbPool& local() {
+    thread_local LimbPool pool;
+    return pool;
+  }
+  // Set once the thread's pool is destroyed; buffers released afterwards,
+  // e.g. by static objects, go straight to the heap.
+  static thread_local bool closed_;
+  static Counters counters_;
+  static void count(std::atomic<uint64_t>& counter) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::array<std::vector<uint64_t*>, 64> free_;
+  size_t cached_limbs_ = 0;
+  size_t cache_limit_ = size_t(1) << 20;
+};
+
+thread_local bool LimbPool::closed_ = false;
+LimbPool::Counters LimbPool::counters_;
+
+// Limb storage with a small inline buffer: values of up to kInlineLimbs limbs
+// (every int64_t among them) never touch the heap.
+class LimbVector {
+ public:
+  static const size_t kInlineLimbs = 3;
+  LimbVector() = default;
+  LimbVector(size_t count, uint64_t value) { assign(count, value); }
+  LimbVector(const std::vector<uint64_t>& other) {
+    assign(other.begin(), other.end());
+  }
+  LimbVector(const LimbVector& other) { assign(other.begin(), other.end()); }
+  LimbVector(LimbVector&& other) noexcept { steal(other); }
+  ~LimbVector() { release(); }
+  LimbVector& operator=(const LimbVector& other) {
+    if (this != &other) {
+      assign(other.begin(), other.end());
+    }
+    return *this;
+  }
+  LimbVector& operator=(LimbVector&& other) noexcept {
+    if (this != &other) {
+      release();
+      steal(other);
+    }
+    return *this;
+  }
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  bool is_inline() const { return data_ == inline_; }
+  uint64_t* data() { return data_; }
+  const uint64_t* data() const { return data_; }
+  uint64_t* begin() { return data_; }
+  const uint64_t* begin() const { return data_; }
+  uint64_t* end() { return data_ + size_; }
+  const uint64_t* end() const { return data_ + size_; }
+  uint64_t& operator[](size_t index) { return data_[index]; }
+  const uint64_t& operator[](size_t index) const { return data_[index]; }
+  uint64_t& back() { return data_[size_ - 1]; }
+  const uint64_t& back() const { return data_[size_ - 1]; }
+  void reserve(size_t capacity) {
+    if (capacity > capacity_) {
+      reallocate(capacity);
+    }
+  }
+  void resize(size_t count, uint64_t value = 0) {
+    if (count > capacity_) {
+      reallocate(std::max(count, 2 * capacity_));
+    }
+    if (count > size_) {
+      std::fill(data_ + size_, data_ + count, value);
+    }
+    size_ = count;
+  }
+  void assign(size_t count, uint64_t value) {
+    size_ = 0;
+    resize(count, value);
+  }
+  template <typename Iterator>
+  void assign(Iterator first, Iterator last) {
+    size_ = 0;
+    reserve(static_cast<size_t>(std::distance(first, last)));
+    size_ = std::copy(first, last, data_) - data_;
+  }
+  // Moves the tail once: in place with memmove, or straight into its final
+  // position in a new buffer when the capacity is exceeded.
+  void insert(uint64_t* position, size_t count, uint64_t value) {
+    size_t offset = position - data_;
+    size_t tail = size_ - offset;
+    if (size_ + count > capacity_) {
+      size_t capacity = std::max(size_ + count, 2 * capacity_);
+      uint64_t* fresh = LimbPool::allocate(capacity);
+      std::memcpy(fresh, data_, offset * sizeof(uint64_t));
+      std::memcpy(fresh + offset + count, data_ + offset,
+                  tail * sizeof(uint64_t));
+      release();
+      data_ = fresh;
+      capacity_ = capacity;
+    } else {
+      std::memmove(data_ + offset + count, data_ + offset,
+                   tail * sizeof(uint64_t));
+    }
+    std::fill(data_ + offset, data_ + offset + count, value);
+    size_ += count;
+  }
+  void push_back(uint64_t value) {
+    if (size_ == capacity_) {
+      reallocate(2 * capacity_ + 1);
+    }
+    data_[size_++] = value;
+  }
+  void pop_back() { --size_; }
+  void clear() { size_ = 0; }
+  bool operator==(const LimbVector& other) const {
+    return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+  }
+
+ private:
+  void reallocate(size_t capacity) {
+    uint64_t* fresh = LimbPool::allocate(capacity);
+    std::copy(data_, data_ + size_, fresh);
+    release();
+    data_ = fresh;
+    capacity_ = capacity;
+  }
+  void release() {
+    if (data_ != inline_) {
+      LimbPool::release(data_, capacity_);
+    }
+  }
+  void steal(LimbVector& other) {
+    size_ = other.size_;
+    if (other.is_inline()) {
+      std::copy(other.inline_, other.inline_ + other.size_, inline_);
+      data_ = inline_;
+      capacity_ = kInlineLimbs;
+    } else {
+      data_ = other.data_;
+      capacity_ = other.capacity_;
+      other.data_ = other.inline_;
+      other.capacity_ = kInlineLimbs;
+    }
+    other.size_ = 0;
+  }
+  uint64_t inline_[kInlineLimbs];
+  uint64_t* data_ = inline_;
+  size_t size_ = 0;
+  size_t capacity_ = kInlineLimbs;
+};
+
+// Operand size (in limbs) from which multiplication uses Karatsuba instead of
+// the schoolbook kernel, and from which Karatsuba branches run on threads.
+const size_t kKaratsubaLimbs = 24;
+const size_t kParallelMultiplyLimbs = 1024;
+
+// Operand size (in limbs) from which the add, subtract and short multiply
+// kernels use vector instructions.
+const size_t kSimdLimbs = 16;
+
+enum class SimdLevel { kScalar, kAvx2, kAvx512 };
+
+// Division by an invariant 64-bit divisor through a precomputed reciprocal
+// (Moller and Granlund, "Improved division by invariant integers"): one
+// 128-bit product and two rarely taken corrections instead of a hardware
+// division per step. The divisor is normalized to have its top bit set.
+class InvariantDivisor {
+ public:
+  explicit InvariantDivisor(uint64_t divisor)
+      : shift_(__builtin_clzll(divisor)),
+        divisor_(divisor << shift_),
+        inverse_(static_cast<uint64_t>(~static_cast<unsigned __int128>(0) /
+                                       divisor_)) {}
+  size_t shift() const { return shift_; }
+  // Divides high * 2^64 + low < divisor() * 2^64 by the normalized divisor,
+  // returns the quotient and stores the remainder.
+  uint64_t divide(uint64_t high, uint64_t low, uint64_t& remainder) const {
+    unsigned __int128 estimate =
+        static_cast<unsigned __int128>(inverse_) * high +
+        (static_cast<unsigned __int128>(high) << 64 | low);
+    uint64_t quotient = static_cast<uint64_t>(estimate >> 64) + 1;
+    uint64_t rest = low - quotient * divisor_;
+    if (rest > static_cast<uint64_t>(estimate)) {
+      --quotient;
+      rest += divisor_;
+    }
+    if (rest >= divisor_) {
+      ++quotient;
+      rest -= divisor_;
+    }
+    remainder = rest;
+    return quotient;
+  }
+  uint64_t divisor() const { return divisor_; }
+
+ private:
+  size_t shift_;
+  uint64_t divisor_;
+  uint64_t inverse_;  // floor((2^128 - 1) / divisor_) - 2^64
+};
+
+// Rounds (mantissa + tail) * 2^exponent to the nearest double, ties to even,
+// where 0 < tail < 1 if sticky and tail = 0 otherwise. Rounds once, also
+// for subnormal results; overflows to infinity.
+double round_to_double(uint64_t mantissa, bool sticky, int64_t exponent) {
+  if (mantissa == 0) {
+    return 0.0;
+  }
+  int leading = __builtin_clzll(mantissa);
+  mantissa <<= leading;
+  exponent -= leading;
+  // mantissa * 2^exponent lies in [2^(exponent + 63), 2^(exponent + 64)).
+  if (exponent + 63 > 1023) {
+    return HUGE_VAL;
+  }
+  int64_t kept = 53;
+  if (exponent + 63 < -1022) {
+    kept -= -1022 - (exponent + 63);
+    if (kept < 0) {
+      return 0.0;
+    }
+  }
+  int drop = static_cast<int>(64 - kept);
+  unsigned __int128 wide = mantissa;
+  unsigned __int128 half = static_cast<unsigned __int128>(1) << (drop - 1);
+  uint64_t result = static_cast<uint64_t>(wide >> drop);
+  unsigned __int128 rest = wide & ((half << 1) - 1);
+  if (rest > half || (rest == half && (sticky || (result & 1) != 0))) {
+    ++result;
+  }
+  return std::ldexp(static_cast<double>(result),
+                    static_cast<int>(exponent) + drop);
+}
+
+SimdLevel detect_simd_level() {
+#ifdef BIGINTEGER_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return SimdLevel::kAvx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdLevel::kAvx2;
+  }
+#endif
+  return SimdLevel::kScalar;
+}
+
 class BigInteger;
+struct GcdMatrix;
 std::ostream& operator<<(std::ostream& out, const BigInteger& value);
 BigInteger operator-(const BigInteger& first, const BigInteger& second);
 
@@ -22,6 +394,9 @@ bool operator<(const BigInteger& first, const BigInteger& other);
 bool operator>(const BigInteger& first, const BigInteger& other);
 bool operator>=(const BigInteger& first, const BigInteger& other);
 bool operator<=(const BigInteger& first, const BigInteger& other);
+BigInteger pow(const BigInteger& base, uint64_t exponent);
+BigInteger multiply(const BigInteger& first, const BigInteger& second,
+                    size_t threads);
 
 class BigInteger {
  public:
@@ -31,213 +406,91 @@ class BigInteger {
   BigInteger(const BigInteger& other, bool sign)
       : sign_(sign), blocks_(other.blocks_) {}
   BigInteger& operator=(const BigInteger& other) = default;
+  BigInteger(BigInteger&& other) noexcept
+      : sign_(other.sign_), blocks_(std::move(other.blocks_)) {
+    other.set_small(0);
+  }
+  BigInteger& operator=(BigInteger&& other) noexcept {
+    if (this != &other) {
+      sign_ = other.sign_;
+      blocks_ = std::move(other.blocks_);
+      other.set_small(0);
+    }
+    return *this;
+  }
   BigInteger(bool sign, const std::vector<uint64_t>& blocks)
       : sign_(sign), blocks_(blocks) {}
-  BigInteger(int64_t value) {
-    sign_ = value >= 0;
-    value = std::abs(value);
-    if (value == 0) {
-      blocks_.push_back(0);
-      return;
-    }
-    while (value != 0) {
-      blocks_.push_back(value % base_);
-      value /= base_;
-    }
+  BigInteger(int64_t value) { set_small(value); }
+  static BigInteger from_unsigned(uint64_t value) {
+    BigInteger result;
+    result.set_magnitude(true, value);
+    return result;
   }
   BigInteger(const std::string& str) {
-    if (str[0] == '-') {
-      if (str[1] == '0') {
-        sign_ = true;
-        blocks_.push_back(0);
-        return;
-      }
-      sign_ = false;
-      blocks_.resize((str.size() + base_power_ - 2) / base_power_, 0);
-    } else {
-      blocks_.resize((str.size() + base_power_ - 1) / base_power_, 0);
-    }
-    for (size_t block = 0; block < blocks_.size(); ++block) {
-      size_t j = 0;
-      int current = str.size() - (block + 1) * base_power_ + j;
-      while (current < 0) {
-        ++current;
-        ++j;
-      }
-      if (current == 0 && str[0] == '-') {
-        ++current;
-        ++j;
-      }
-      while (j != base_power_ && current < static_cast<int>(str.size()) &&
-             current >= 0) {
-        blocks_[block] = blocks_[block] * 10 + (str[current] - '0');
-        ++j;
-        ++current;
-      }
+    size_t begin = (!str.empty() && (str[0] == '-' || str[0] == '+')) ? 1 : 0;
+    sign_ = (begin == 0 || str[0] != '-');
+    size_t end = str.size();
+    blocks_.assign(std::max<size_t>(1, (end - begin + base_power_ - 1) /
+                                           base_power_),
+                   0);
+    for (size_t block = 0; end > begin; ++block) {
+      size_t from = end - begin > base_power_ ? end - base_power_ : begin;
+      blocks_[block] = read_digits(str.data() + from, end - from);
+      end = from;
     }
+    check_zeroes();
   }
   BigInteger& operator+=(const BigInteger& other) {
-    if (!is_negative() && other.is_negative()) {
-      return (*this -= (-other));
-    }
-    if (is_negative() && !other.is_negative()) {
-      return (*this -= (-other));
-    }
-    size_t max_sz = std::max(size(), other.size());
-    blocks_.resize(max_sz, 0);
-    uint64_t tmp = 0;
-    for (size_t i = 0; i < other.size(); ++i) {
-      tmp += blocks_[i] + other.blocks_[i];
-      blocks_[i] = tmp % base_;
-      tmp = tmp / base_;
-    }
-    if (tmp != 0) {
-      size_t i = other.size();
-      while (tmp != 0 && i != size()) {
-        tmp += blocks_[i];
-        blocks_[i] = tmp % base_;
-        tmp = tmp / base_;
-        ++i;
-      }
-      if (i == size()) {
-        while (tmp != 0) {
-          blocks_.push_back(tmp % base_);
-          tmp /= base_;
-        }
-      }
+    if (size() == 1 && other.size() == 1) {
+      set_small(small_value() + other.small_value());
+      return *this;
+    }
+    if (sign_ == other.sign_) {
+      add_abs(other);
+    } else if (sub_abs(other)) {
+      sign_ = other.sign_;
     }
+    check_zeroes();
     return *this;
   }
   BigInteger& operator-=(const BigInteger& other) {
-    if (is_positive() && other.is_negative()) {
-      return (*this += (-other));
-    }
-    if (is_negative() && other.is_positive()) {
-      return (*this += (-other));
-    }
-    if (is_negative() && other.is_negative()) {
-      return (*this = -((-*this) - (-other)));
+    if (size() == 1 && other.size() == 1) {
+      set_small(small_value() - other.small_value());
+      return *this;
     }
-    bool sign_result = (*this >= other);
-    sign_ = true;
-    BigInteger max = abs_max(other);
-    BigInteger min = abs_min(other);
-    int64_t tmp = 0;
-    for (size_t i = 0; i < min.size(); ++i) {
-      tmp += static_cast<int64_t>(max.blocks_[i]) -
-             static_cast<int64_t>(min.blocks_[i]);
-      if (tmp >= 0) {
-        max.blocks_[i] = tmp % base_;
-        tmp = tmp / base_;
-      } else {
-        max.blocks_[i] = base_ + tmp;
-        tmp = -1;
-      }
-    }
-    if (tmp != 0) {
-      size_t i = min.size();
-      while (tmp != 0 && i != max.size()) {
-        tmp += max.blocks_[i];
-        if (tmp >= 0) {
-          max.blocks_[i] = tmp % base_;
-          tmp = tmp / base_;
-        } else {
-          max.blocks_[i] = base_ + tmp;
-          tmp = -1;
-        }
-        ++i;
-      }
-      while (tmp != 0) {
-        if (tmp >= 0) {
-          max.blocks_.push_back(tmp % base_);
-          tmp = tmp / base_;
-        } else {
-          max.blocks_.push_back(base_ + tmp);
-          tmp = -1;
-        }
-      }
+    if (sign_ != other.sign_) {
+      add_abs(other);
+    } else if (sub_abs(other)) {
+      sign_ = !sign_;
     }
-    max.check_zeroes();
-    *this = max;
-    sign_ = sign_result;
+    check_zeroes();
     return *this;
   }
   BigInteger operator-() const {
-    if (*this == 0) {
-      return *this;
-    }
-    return BigInteger(!sign_, blocks_);
+    return BigInteger(*this, !sign_ || is_zero());
   }
   BigInteger operator+() const { return *this; }
   BigInteger& operator*=(const BigInteger& other) {
-    bool sign_result;
-    if ((is_negative() && other.is_negative()) ||
-        (!is_negative() && !other.is_negative())) {
-      sign_result = true;
-    } else {
-      sign_result = false;
-    }
-    sign_ = true;
-    if (other == 0 || *this == 0) {
-      *this = 0;
+    if (size() == 1 && other.size() == 1) {
+      set_small(small_value() * other.small_value());
       return *this;
     }
-    BigInteger result;
-    for (size_t i = 0; i < other.size(); ++i) {
-      BigInteger tmp(*this);
-      tmp.short_mult(other.blocks_[i]);
-      result.add_with_shift(tmp, i);
+    if (other.size() == 1) {
+      short_mult(other.small_value());
+      return *this;
     }
-    *this = result;
-    sign_ = sign_result;
+    BigInteger product;
+    product.assign_product(*this, other, concurrency_);
+    return *this = std::move(product);
+  }
+  BigInteger& operator/=(int64_t value) {
+    short_div(value);
     return *this;
   }
   BigInteger& operator/=(const BigInteger& other) {
-    bool sign_result;
-    if ((is_negative() && other.is_negative()) ||
-        (is_positive() && other.is_positive())) {
-      sign_result = true;
-    } else {
-      sign_result = false;
-    }
-    sign_ = true;
-    if (*this == 0 || abs_lower(other)) {
-      *this = 0;
-      return *this;
-    }
-    if (other == 1 || other == -1) {
-      sign_ = sign_result;
-      return *this;
-    }
-    int max_size = size() - other.size();
-    BigInteger other_cp = BigInteger(other, true);
-    BigInteger result = power(max_size);
-    for (int i = max_size; i >= 0; --i) {
-      int64_t left = 0;
-      int64_t right = base_;
-      while (true) {
-        int64_t middle = (right + left) >> 1;
-        BigInteger tmp = other_cp;
-        tmp.short_mult(middle);
-        tmp.shift(i);
-        if (tmp > *this) {
-          right = middle;
-        } else {
-          left = middle;
-        }
-        if (right - left == 1) {
-          tmp = other_cp;
-          tmp.short_mult(left);
-          tmp.shift(i);
-          *this -= tmp;
-          result.blocks_[i] = left;
-          break;
-        }
-      }
-    }
-    result.check_zeroes();
-    *this = result;
-    sign_ = sign_result;
+    bool sign_result = (sign_ == other.sign_);
+    divide_abs(other, nullptr);
+    sign_ = sign_result || is_zero();
     return *this;
   }
   BigInteger& operator++() {
@@ -259,99 +512,158 @@ class BigInteger {
     return old;
   }
   std::string toString() const {
-    std::string result;
-    if (sign_ == false) {
-      result.push_back('-');
-    }
-    result += std::to_string(*blocks_.rbegin());
-    for (auto i = blocks_.rbegin() + 1; i != blocks_.rend(); ++i) {
-      size_t count = count_digits(*i);
-      while (count < base_power_) {
-        ++count;
-        result.push_back('0');
-      }
-      if (*i != 0) {
-        result += std::to_string(*i);
-      }
+    size_t top_length = std::max<size_t>(1, count_digits(blocks_.back()));
+    size_t sign_length = sign_ ? 0 : 1;
+    std::string result(sign_length + top_length + (size() - 1) * base_power_,
+                       '-');
+    char* position = &result[0] + result.size();
+    for (size_t i = 0; i + 1 < size(); ++i) {
+      position -= base_power_;
+      write_digits(position, blocks_[i], base_power_);
     }
+    write_digits(position - top_length, blocks_.back(), top_length);
     return result;
   }
-  explicit operator bool() const { return *this != BigInteger(0); }
+  explicit operator bool() const { return !is_zero(); }
+  // Correctly rounded; anything of more than 35 limbs is at least 10^315 and
+  // converts to infinity, so at most 35 limbs are read.
   explicit operator double() const {
-    double ans = 0;
-    for (size_t i = 0; i < blocks_.size(); ++i) {
-      ans *= base_;
-      ans += blocks_[blocks_.size() - 1 - i];
+    if (size() > 35) {
+      return sign_ ? HUGE_VAL : -HUGE_VAL;
     }
-    return ans;
-  }
-  bool abs_equal(const BigInteger& other) {
-    if (size() != other.size()) {
-      return false;
+    std::array<uint64_t, 18> words{};
+    size_t count = 0;
+    for (size_t i = size(); i != 0; --i) {
+      unsigned __int128 carry = blocks_[i - 1];
+      for (size_t j = 0; j < count; ++j) {
+        carry += static_cast<unsigned __int128>(words[j]) * base_;
+        words[j] = static_cast<uint64_t>(carry);
+        carry >>= 64;
+      }
+      if (carry != 0) {
+        words[count++] = static_cast<uint64_t>(carry);
+      }
     }
-    return blocks_ == other.blocks_;
-  }
-  BigInteger abs_max(const BigInteger& other) {
-    if (size() > other.size()) {
-      return BigInteger(*this, true);
+    if (count == 0) {
+      return 0.0;
     }
-    if (size() < other.size()) {
-      return BigInteger(other, true);
+    size_t bits = 64 * count - __builtin_clzll(words[count - 1]);
+    size_t shift = bits > 64 ? bits - 64 : 0;
+    size_t word = shift / 64;
+    size_t offset = shift % 64;
+    uint64_t mantissa = words[word] >> offset;
+    if (offset != 0 && word + 1 < count) {
+      mantissa |= words[word + 1] << (64 - offset);
     }
-    size_t i = size();
-    do {
-      --i;
-      if (blocks_[i] < other.blocks_[i]) {
-        return BigInteger(other, true);
-      } else if (blocks_[i] != other.blocks_[i]) {
-        return BigInteger(*this, true);
-      }
-    } while (i != 0);
-    return BigInteger(*this, true);
-  }
-  BigInteger abs_min(const BigInteger& other) {
-    if (size() > other.size()) {
-      return BigInteger(other, true);
+    bool sticky = offset != 0 && (words[word] << (64 - offset)) != 0;
+    for (size_t i = 0; i < word; ++i) {
+      sticky = sticky || words[i] != 0;
     }
-    if (size() < other.size()) {
-      return BigInteger(*this, true);
+    double result = round_to_double(mantissa, sticky, shift);
+    return sign_ ? result : -result;
+  }
+  // Three-way comparisons (-1, 0 or 1) straight on the limb spans.
+  int compare(const BigInteger& other) const {
+    if (sign_ != other.sign_) {
+      return sign_ ? 1 : -1;
     }
-    size_t i = size();
-    do {
-      --i;
-      if (blocks_[i] < other.blocks_[i]) {
-        return BigInteger(*this, true);
-      } else if (blocks_[i] != other.blocks_[i]) {
-        return BigInteger(other, true);
-      }
-    } while (i != 0);
-    return BigInteger(other, true);
+    int result = compare_abs(other);
+    return sign_ ? result : -result;
+  }
+  int compare_abs(const BigInteger& other) const {
+    return compare_limbs(blocks_.data(), size(), other.blocks_.data(),
+                         other.size());
+  }
+  bool abs_equal(const BigInteger& other) const {
+    return compare_abs(other) == 0;
+  }
+  BigInteger abs_max(const BigInteger& other) const {
+    return BigInteger(compare_abs(other) < 0 ? other : *this, true);
+  }
+  BigInteger abs_min(const BigInteger& other) const {
+    return BigInteger(compare_abs(other) < 0 ? *this : other, true);
   }
   bool is_negative() const { return sign_ == false; }
-  bool is_positive() const { return sign_ == true && *this != 0; }
-  void change_sign() { sign_ ^= true; }
+  bool is_positive() const { return sign_ == true && !is_zero(); }
+  void change_sign() { sign_ = !sign_ || is_zero(); }
   void check_zeroes() {
-    bool all_is_zero = false;
-    int i = blocks_.size() - 1;
-    while (i > 0) {
-      if (blocks_[i] == 0) {
-        blocks_.pop_back();
-      } else {
-        all_is_zero = false;
-        break;
-      }
-      --i;
+    while (blocks_.size() > 1 && blocks_.back() == 0) {
+      blocks_.pop_back();
     }
-    if (all_is_zero) {
-      blocks_.clear();
-      blocks_.push_back(0);
+    if (is_zero()) {
       sign_ = true;
     }
   }
+  bool is_zero() const { return blocks_.size() == 1 && blocks_[0] == 0; }
+  bool is_odd() const { return blocks_[0] % 2 == 1; }
+  // Approximate natural logarithm of |*this| from the two leading limbs;
+  // -infinity for zero.
+  double log_abs() const {
+    double leading = static_cast<double>(leading_limbs(size()));
+    double scale = size() >= 2 ? static_cast<double>(size() - 2) : -1.0;
+    return std::log(leading) + scale * std::log(static_cast<double>(base_));
+  }
+  // |*this| mod value for value > 0, without a copy.
+  uint64_t abs_mod(uint64_t value) const {
+    return short_div_limbs(nullptr, blocks_.data(), size(),
+                           InvariantDivisor(value));
+  }
+  // Little-endian base 2^32 digits of |*this|.
+  std::vector<uint32_t> binary_words() const {
+    std::vector<uint32_t> words;
+    BigInteger rest(*this, true);
+    while (!rest.is_zero()) {
+      words.push_back(static_cast<uint32_t>(rest.short_div_abs(1ull << 32)));
+    }
+    return words;
+  }
   bool sign() const { return sign_; }
   size_t size() const { return blocks_.size(); }
+  // Threads a single large multiplication may use; 1 keeps it sequential.
+  // The result does not depend on this setting.
+  static void set_concurrency(size_t threads) {
+    concurrency_ = std::max<size_t>(threads, 1);
+  }
+  static size_t concurrency() { return concurrency_; }
+  // Vector instructions used by the limb kernels; requests above what the
+  // processor supports are lowered to the best supported level.
+  static void set_simd_level(SimdLevel level) {
+    simd_level_ = std::min(level, detect_simd_level());
+  }
+  static SimdLevel simd_level() { return simd_level_; }
   friend bool operator==(const BigInteger& first, const BigInteger& other);
   friend bool operator<(const BigInteger& first, const BigInteger& other);
+  friend BigInteger operator*(const BigInteger& first,
+                              const BigInteger& second);
+  friend bool lehmer_step(BigInteger& first, BigInteger& second,
+                          GcdMatrix* matrix);
+  friend void euclid_reduce(BigInteger& first, BigInteger& second,
+                            GcdMatrix* matrix, size_t stop_size);
+  friend class MontgomeryContext;
+  friend class BigIntegerView;
+  friend class BigIntegerAccumulator;
+  friend void serialize(const BigInteger& value, std::vector<uint8_t>& out);
+  friend void divmod(const BigInteger& first, const BigInteger& second,
+                     BigInteger& quotient, BigInteger& remainder);
+  friend void divmod_small(const BigInteger& first, int64_t second,
+                           BigInteger& quotient, int64_t& remainder);
+  friend BigInteger iroot(const BigInteger& value, uint64_t degree);
+  friend BigInteger pow(const BigInteger& base, uint64_t exponent);
+  friend BigInteger multiply(const BigInteger& first,
+                             const BigInteger& second, size_t threads);
+  friend double ratio_to_double(const BigInteger& numerator,
+                                const BigInteger& denominator);
+  void decimal_shift(size_t digits) {
+    if (is_zero()) {
+      return;
+    }
+    shift(digits / base_power_);
+    uint64_t multiplier = 1;
+    for (size_t i = 0; i < digits % base_power_; ++i) {
+      multiplier *= 10;
+    }
+    short_mult(multiplier);
+  }
   BigInteger power(int64_t power) {
     BigInteger res(0);
     res.blocks_.clear();
@@ -364,162 +676,877 @@ class BigInteger {
   }
 
  private:
+  // Single-limb values and their sums, differences and products fit int64_t.
+  int64_t small_value() const {
+    return sign_ ? static_cast<int64_t>(blocks_[0])
+                 : -static_cast<int64_t>(blocks_[0]);
+  }
+  void set_small(int64_t value) {
+    set_magnitude(value >= 0, value >= 0 ? static_cast<uint64_t>(value)
+                                         : 0 - static_cast<uint64_t>(value));
+  }
+  void set_magnitude(bool sign, uint64_t magnitude) {
+    sign_ = sign;
+    blocks_.clear();
+    do {
+      blocks_.push_back(magnitude % base_);
+      magnitude /= base_;
+    } while (magnitude != 0);
+  }
   void shift(size_t shift) { blocks_.insert(blocks_.begin(), shift, 0); }
-  void add_with_shift(const BigInteger& other, size_t shift) {
-    BigInteger tmp(other);
-    tmp.blocks_.insert(tmp.blocks_.begin(), shift, 0);
-    *this += tmp;
+  // Limb-span kernels. `result` may alias `first`; add_limbs and sub_limbs
+  // need first_size >= second_size, sub_limbs also |first| >= |second|.
+  static uint64_t add_limbs(uint64_t* result, const uint64_t* first,
+                            size_t first_size, const uint64_t* second,
+                            size_t second_size) {
+    uint64_t carry = 0;
+    size_t i = 0;
+#ifdef BIGINTEGER_X86_SIMD
+    if (second_size >= kSimdLimbs && simd_level_ == SimdLevel::kAvx512) {
+      i = add_limbs_avx512(result, first, second, second_size, carry);
+    } else if (second_size >= kSimdLimbs && simd_level_ == SimdLevel::kAvx2) {
+      i = add_limbs_avx2(result, first, second, second_size, carry);
+    }
+#endif
+    for (; i < second_size; ++i) {
+      uint64_t sum = first[i] + second[i] + carry;
+      carry = sum >= static_cast<uint64_t>(base_) ? 1 : 0;
+      result[i] = sum - carry * base_;
+    }
+    for (size_t i = second_size; i < first_size; ++i) {
+      if (carry == 0 && result == first) {
+        break;
+      }
+      uint64_t sum = first[i] + carry;
+      carry = sum >= static_cast<uint64_t>(base_) ? 1 : 0;
+      result[i] = sum - carry * base_;
+    }
+    return carry;
   }
-  void short_div(int64_t value) {
-    if ((is_negative() && value < 0) || (!is_negative() && value >= 0)) {
-      sign_ = true;
-    } else {
-      sign_ = false;
+  static void sub_limbs(uint64_t* result, const uint64_t* first,
+                        size_t first_size, const uint64_t* second,
+                        size_t second_size) {
+    uint64_t borrow = 0;
+    size_t i = 0;
+#ifdef BIGINTEGER_X86_SIMD
+    if (second_size >= kSimdLimbs && simd_level_ == SimdLevel::kAvx512) {
+      i = sub_limbs_avx512(result, first, second, second_size, borrow);
+    } else if (second_size >= kSimdLimbs && simd_level_ == SimdLevel::kAvx2) {
+      i = sub_limbs_avx2(result, first, second, second_size, borrow);
     }
-    if (value == 0) {
-      throw std::overflow_error("Divide by zero exception");
+#endif
+    for (; i < second_size; ++i) {
+      uint64_t subtrahend = second[i] + borrow;
+      borrow = first[i] < subtrahend ? 1 : 0;
+      result[i] = first[i] + borrow * base_ - subtrahend;
     }
-    value = std::abs(value);
-    BigInteger result;
-    result.blocks_.resize(blocks_.size(), 0);
-    uint64_t tmp = 0;
-    size_t i = size();
-    do {
-      --i;
-      int64_t cur = blocks_[i] + tmp * base_;
-      result.blocks_[i] = cur / value;
-      tmp = cur % value;
-    } while (i != 0);
-    while (result.blocks_.size() > 1 &&
-           result.blocks_[result.blocks_.size() - 1] == 0) {
-      result.blocks_.pop_back();
+    for (size_t i = second_size; i < first_size; ++i) {
+      if (borrow == 0 && result == first) {
+        break;
+      }
+      uint64_t next_borrow = first[i] < borrow ? 1 : 0;
+      result[i] = first[i] + next_borrow * base_ - borrow;
+      borrow = next_borrow;
+    }
+  }
+  // result[0, size) = value * factor + carry for factor < base_; returns the
+  // outgoing carry. result may alias value.
+  static uint64_t short_mult_limbs(uint64_t* result, const uint64_t* value,
+                                   size_t size, uint64_t factor,
+                                   uint64_t carry = 0) {
+    size_t i = 0;
+#ifdef BIGINTEGER_X86_SIMD
+    if (size >= kSimdLimbs && simd_level_ == SimdLevel::kAvx512) {
+      i = short_mult_limbs_avx512(result, value, size, factor, carry);
+    } else if (size >= kSimdLimbs && simd_level_ == SimdLevel::kAvx2) {
+      i = short_mult_limbs_avx2(result, value, size, factor, carry);
     }
-    if (result.blocks_.size() == 0) {
-      result.blocks_.push_back(0);
+#endif
+    for (; i < size; ++i) {
+      uint64_t cur = value[i] * factor + carry;
+      result[i] = cur % base_;
+      carry = cur / base_;
     }
-    *this = result;
+    return carry;
   }
-  void short_mult(int64_t value) {
-    if ((is_negative() && value < 0) || (!is_negative() && value >= 0)) {
-      sign_ = true;
-    } else {
-      sign_ = false;
+#ifdef BIGINTEGER_X86_SIMD
+// GCC 12 flags the undefined pass-through operands inside the AVX-512
+// intrinsics as maybe-uninitialized.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+  // Vector kernels for the leading size - size % lanes limbs; they return
+  // the number of limbs done and update carry. Per lane, a sum of at least
+  // base_ generates a carry and a sum of base_ - 1 propagates one, so the
+  // incoming carries of a whole vector are ((G << 1 | carry) + P) ^ P for
+  // the generate and propagate bit masks G and P (carry lookahead).
+  __attribute__((target("avx2"))) static size_t add_limbs_avx2(
+      uint64_t* result, const uint64_t* first, const uint64_t* second,
+      size_t size, uint64_t& carry) {
+    const __m256i base = _mm256_set1_epi64x(base_);
+    const __m256i top = _mm256_set1_epi64x(base_ - 1);
+    const __m256i bits = _mm256_setr_epi64x(1, 2, 4, 8);
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+      __m256i sum = _mm256_add_epi64(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + i)),
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + i)));
+      unsigned generate = _mm256_movemask_pd(
+          _mm256_castsi256_pd(_mm256_cmpgt_epi64(sum, top)));
+      unsigned propagate = _mm256_movemask_pd(
+          _mm256_castsi256_pd(_mm256_cmpeq_epi64(sum, top)));
+      unsigned chain = ((generate << 1) | carry) + propagate;
+      __m256i carries = _mm256_set1_epi64x((chain ^ propagate) & 15);
+      carries = _mm256_cmpeq_epi64(_mm256_and_si256(carries, bits), bits);
+      carry = chain >> 4;
+      sum = _mm256_sub_epi64(sum, carries);
+      sum = _mm256_sub_epi64(
+          sum, _mm256_and_si256(_mm256_cmpgt_epi64(sum, top), base));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), sum);
     }
-    if (value == 0) {
-      blocks_.clear();
-      blocks_.push_back(0);
-      return;
+    return i;
+  }
+  __attribute__((target("avx2"))) static size_t sub_limbs_avx2(
+      uint64_t* result, const uint64_t* first, const uint64_t* second,
+      size_t size, uint64_t& borrow) {
+    const __m256i base = _mm256_set1_epi64x(base_);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bits = _mm256_setr_epi64x(1, 2, 4, 8);
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+      __m256i difference = _mm256_sub_epi64(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + i)),
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + i)));
+      unsigned generate = _mm256_movemask_pd(
+          _mm256_castsi256_pd(_mm256_cmpgt_epi64(zero, difference)));
+      unsigned propagate = _mm256_movemask_pd(
+          _mm256_castsi256_pd(_mm256_cmpeq_epi64(difference, zero)));
+      unsigned chain = ((generate << 1) | borrow) + propagate;
+      __m256i borrows = _mm256_set1_epi64x((chain ^ propagate) & 15);
+      borrows = _mm256_cmpeq_epi64(_mm256_and_si256(borrows, bits), bits);
+      borrow = chain >> 4;
+      difference = _mm256_add_epi64(difference, borrows);
+      difference = _mm256_add_epi64(
+          difference,
+          _mm256_and_si256(_mm256_cmpgt_epi64(zero, difference), base));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), difference);
     }
-    value = std::abs(value);
-    uint64_t tmp = 0;
-    for (size_t i = 0; i < size(); ++i) {
-      tmp += blocks_[i] * value;
-      blocks_[i] = tmp % base_;
-      tmp = tmp / base_;
+    return i;
+  }
+  // The quotients value[i] * factor / base_ are estimated in double
+  // precision and corrected by one; lane i then adds the quotient of lane
+  // i - 1 to its remainder, which again carries at most one.
+  __attribute__((target("avx2"))) static size_t short_mult_limbs_avx2(
+      uint64_t* result, const uint64_t* value, size_t size, uint64_t factor,
+      uint64_t& carry) {
+    const __m256i base = _mm256_set1_epi64x(base_);
+    const __m256i top = _mm256_set1_epi64x(base_ - 1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bits = _mm256_setr_epi64x(1, 2, 4, 8);
+    const __m256i multiplier = _mm256_set1_epi64x(factor);
+    const __m256i even_lanes = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+    const __m256d ratio =
+        _mm256_set1_pd(static_cast<double>(factor) / base_);
+    __m256i previous = _mm256_set1_epi64x(carry);
+    unsigned carry_bit = 0;
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+      __m256i limbs =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(value + i));
+      __m256i product = _mm256_mul_epu32(limbs, multiplier);
+      __m256d estimate = _mm256_mul_pd(
+          _mm256_cvtepi32_pd(_mm256_castsi256_si128(
+              _mm256_permutevar8x32_epi32(limbs, even_lanes))),
+          ratio);
+      __m256i quotient = _mm256_cvtepu32_epi64(_mm256_cvttpd_epi32(estimate));
+      __m256i remainder =
+          _mm256_sub_epi64(product, _mm256_mul_epu32(quotient, base));
+      __m256i low = _mm256_cmpgt_epi64(zero, remainder);
+      remainder = _mm256_add_epi64(remainder, _mm256_and_si256(low, base));
+      quotient = _mm256_add_epi64(quotient, low);
+      __m256i high = _mm256_cmpgt_epi64(remainder, top);
+      remainder = _mm256_sub_epi64(remainder, _mm256_and_si256(high, base));
+      quotient = _mm256_sub_epi64(quotient, high);
+      __m256i rotated = _mm256_permute4x64_epi64(quotient, 0x93);
+      __m256i sum = _mm256_add_epi64(
+          remainder, _mm256_blend_epi32(rotated, previous, 0x03));
+      previous = rotated;
+      unsigned generate = _mm256_movemask_pd(
+          _mm256_castsi256_pd(_mm256_cmpgt_epi64(sum, top)));
+      unsigned propagate = _mm256_movemask_pd(
+          _mm256_castsi256_pd(_mm256_cmpeq_epi64(sum, top)));
+      unsigned chain = ((generate << 1) | carry_bit) + propagate;
+      __m256i carries = _mm256_set1_epi64x((chain ^ propagate) & 15);
+      carries = _mm256_cmpeq_epi64(_mm256_and_si256(carries, bits), bits);
+      carry_bit = chain >> 4;
+      sum = _mm256_sub_epi64(sum, carries);
+      sum = _mm256_sub_epi64(
+          sum, _mm256_and_si256(_mm256_cmpgt_epi64(sum, top), base));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), sum);
     }
-    while (tmp != 0) {
-      blocks_.push_back(tmp % base_);
-      tmp = tmp / base_;
+    carry = static_cast<uint64_t>(_mm256_extract_epi64(previous, 0)) +
+            carry_bit;
+    return i;
+  }
+  __attribute__((target("avx512f"))) static size_t add_limbs_avx512(
+      uint64_t* result, const uint64_t* first, const uint64_t* second,
+      size_t size, uint64_t& carry) {
+    const __m512i base = _mm512_set1_epi64(base_);
+    const __m512i top = _mm512_set1_epi64(base_ - 1);
+    const __m512i one = _mm512_set1_epi64(1);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      __m512i sum = _mm512_add_epi64(_mm512_loadu_si512(first + i),
+                                     _mm512_loadu_si512(second + i));
+      unsigned generate = _mm512_cmpgt_epu64_mask(sum, top);
+      unsigned propagate = _mm512_cmpeq_epu64_mask(sum, top);
+      unsigned chain = ((generate << 1) | carry) + propagate;
+      carry = chain >> 8;
+      sum = _mm512_mask_add_epi64(sum, (chain ^ propagate) & 255, sum, one);
+      sum = _mm512_mask_sub_epi64(sum, _mm512_cmpgt_epu64_mask(sum, top), sum,
+                                  base);
+      _mm512_storeu_si512(result + i, sum);
     }
+    return i;
   }
-  bool abs_lower(const BigInteger& other) {
-    if (size() > other.size()) {
-      return false;
+  __attribute__((target("avx512f"))) static size_t sub_limbs_avx512(
+      uint64_t* result, const uint64_t* first, const uint64_t* second,
+      size_t size, uint64_t& borrow) {
+    const __m512i base = _mm512_set1_epi64(base_);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one = _mm512_set1_epi64(1);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      __m512i minuend = _mm512_loadu_si512(first + i);
+      __m512i subtrahend = _mm512_loadu_si512(second + i);
+      __m512i difference = _mm512_sub_epi64(minuend, subtrahend);
+      unsigned generate = _mm512_cmplt_epu64_mask(minuend, subtrahend);
+      unsigned propagate = _mm512_cmpeq_epu64_mask(minuend, subtrahend);
+      unsigned chain = ((generate << 1) | borrow) + propagate;
+      borrow = chain >> 8;
+      difference = _mm512_mask_sub_epi64(
+          difference, (chain ^ propagate) & 255, difference, one);
+      difference = _mm512_mask_add_epi64(
+          difference, _mm512_cmplt_epi64_mask(difference, zero), difference,
+          base);
+      _mm512_storeu_si512(result + i, difference);
     }
-    if (size() < other.size()) {
-      return true;
+    return i;
+  }
+  __attribute__((target("avx512f"))) static size_t short_mult_limbs_avx512(
+      uint64_t* result, const uint64_t* value, size_t size, uint64_t factor,
+      uint64_t& carry) {
+    const __m512i base = _mm512_set1_epi64(base_);
+    const __m512i top = _mm512_set1_epi64(base_ - 1);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one = _mm512_set1_epi64(1);
+    const __m512i multiplier = _mm512_set1_epi64(factor);
+    const __m512d ratio =
+        _mm512_set1_pd(static_cast<double>(factor) / base_);
+    __m512i previous = _mm512_set1_epi64(carry);
+    unsigned carry_bit = 0;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      __m512i limbs = _mm512_loadu_si512(value + i);
+      __m512i product = _mm512_mul_epu32(limbs, multiplier);
+      __m512d estimate = _mm512_mul_pd(
+          _mm512_cvtepi32_pd(_mm512_cvtepi64_epi32(limbs)), ratio);
+      __m512i quotient = _mm512_cvtepu32_epi64(_mm512_cvttpd_epi32(estimate));
+      __m512i remainder =
+          _mm512_sub_epi64(product, _mm512_mul_epu32(quotient, base));
+      __mmask8 low = _mm512_cmplt_epi64_mask(remainder, zero);
+      remainder = _mm512_mask_add_epi64(remainder, low, remainder, base);
+      quotient = _mm512_mask_sub_epi64(quotient, low, quotient, one);
+      __mmask8 high = _mm512_cmpgt_epi64_mask(remainder, top);
+      remainder = _mm512_mask_sub_epi64(remainder, high, remainder, base);
+      quotient = _mm512_mask_add_epi64(quotient, high, quotient, one);
+      __m512i sum = _mm512_add_epi64(
+          remainder, _mm512_alignr_epi64(quotient, previous, 7));
+      previous = quotient;
+      unsigned generate = _mm512_cmpgt_epu64_mask(sum, top);
+      unsigned propagate = _mm512_cmpeq_epu64_mask(sum, top);
+      unsigned chain = ((generate << 1) | carry_bit) + propagate;
+      carry_bit = chain >> 8;
+      sum = _mm512_mask_add_epi64(sum, (chain ^ propagate) & 255, sum, one);
+      sum = _mm512_mask_sub_epi64(sum, _mm512_cmpgt_epu64_mask(sum, top), sum,
+                                  base);
+      _mm512_storeu_si512(result + i, sum);
     }
-    if (size() == 0) {
-      return false;
+    alignas(64) uint64_t lanes[8];
+    _mm512_store_si512(lanes, previous);
+    carry = lanes[7] + carry_bit;
+    return i;
+  }
+  // Little-endian 32-bit images of the limbs for serialization.
+  __attribute__((target("avx2"))) static size_t store_limbs_avx2(
+      uint8_t* out, const uint64_t* limbs, size_t size) {
+    const __m256i even_lanes = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+      __m256i wide =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(limbs + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i),
+                       _mm256_castsi256_si128(
+                           _mm256_permutevar8x32_epi32(wide, even_lanes)));
     }
-    size_t i = size();
-    do {
-      --i;
-      if (blocks_[i] < other.blocks_[i]) {
-        return true;
-      } else if (blocks_[i] != other.blocks_[i]) {
-        return false;
-      }
-    } while (i != 0);
-    return false;
+    return i;
   }
-  static const int64_t base_ = 1000000000;
-  static const size_t base_power_ = 9;
-  bool sign_ = true;  // true <-> non-negative; false <-> negative
-  std::vector<uint64_t> blocks_;
-};
-
-bool operator==(const BigInteger& first, const BigInteger& other) {
-  if (first.size() != other.size() || first.sign() != other.sign()) {
-    return false;
+  __attribute__((target("avx2"))) static size_t load_limbs_avx2(
+      uint64_t* limbs, const uint8_t* in, size_t size) {
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i*>(limbs + i),
+          _mm256_cvtepu32_epi64(
+              _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * i))));
+    }
+    return i;
   }
-  return first.blocks_ == other.blocks_;
-}
-bool operator!=(const BigInteger& first, const BigInteger& other) {
-  return !(first == other);
-}
-bool operator<(const BigInteger& first, const BigInteger& other) {
-  if (!first.is_negative() && other.is_negative()) {
-    return false;
+  __attribute__((target("avx512f"))) static size_t store_limbs_avx512(
+      uint8_t* out, const uint64_t* limbs, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * i),
+                          _mm512_cvtepi64_epi32(_mm512_loadu_si512(limbs + i)));
+    }
+    return i;
   }
-  if (first.is_negative() && !other.is_negative()) {
-    return true;
+  __attribute__((target("avx512f"))) static size_t load_limbs_avx512(
+      uint64_t* limbs, const uint8_t* in, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      _mm512_storeu_si512(limbs + i,
+                          _mm512_cvtepu32_epi64(_mm256_loadu_si256(
+                              reinterpret_cast<const __m256i*>(in + 4 * i))));
+    }
+    return i;
   }
-  if (first.is_negative() && other.is_negative()) {
-    return ((-other) < (-first));
+#pragma GCC diagnostic pop
+#endif
+  static void store_limbs(uint8_t* out, const uint64_t* limbs, size_t size) {
+    size_t i = 0;
+#ifdef BIGINTEGER_X86_SIMD
+    if (size >= kSimdLimbs && simd_level_ == SimdLevel::kAvx512) {
+      i = store_limbs_avx512(out, limbs, size);
+    } else if (size >= kSimdLimbs && simd_level_ == SimdLevel::kAvx2) {
+      i = store_limbs_avx2(out, limbs, size);
+    }
+#endif
+    for (; i < size; ++i) {
+      for (size_t byte = 0; byte < 4; ++byte) {
+        out[4 * i + byte] = static_cast<uint8_t>(limbs[i] >> (8 * byte));
+      }
+    }
   }
-  if (first.size() > other.size()) {
-    return false;
+  static void load_limbs(uint64_t* limbs, const uint8_t* in, size_t size) {
+    size_t i = 0;
+#ifdef BIGINTEGER_X86_SIMD
+    if (size >= kSimdLimbs && simd_level_ == SimdLevel::kAvx512) {
+      i = load_limbs_avx512(limbs, in, size);
+    } else if (size >= kSimdLimbs && simd_level_ == SimdLevel::kAvx2) {
+      i = load_limbs_avx2(limbs, in, size);
+    }
+#endif
+    for (; i < size; ++i) {
+      limbs[i] = 0;
+      for (size_t byte = 0; byte < 4; ++byte) {
+        limbs[i] |= static_cast<uint64_t>(in[4 * i + byte]) << (8 * byte);
+      }
+    }
   }
-  if (first.size() < other.size()) {
-    return true;
+  static int compare_limbs(const uint64_t* first, size_t first_size,
+                           const uint64_t* second, size_t second_size) {
+    if (first_size != second_size) {
+      return first_size < second_size ? -1 : 1;
+    }
+    for (size_t i = first_size; i != 0; --i) {
+      if (first[i - 1] != second[i - 1]) {
+        return first[i - 1] < second[i - 1] ? -1 : 1;
+      }
+    }
+    return 0;
   }
-  if (first.size() == 0) {
-    return false;
+  // result[0, first_size + second_size) must be zeroed and must not alias.
+  static void mult_limbs(uint64_t* result, const uint64_t* first,
+                         size_t first_size, const uint64_t* second,
+                         size_t second_size) {
+    for (size_t i = 0; i < first_size; ++i) {
+      uint64_t carry = 0;
+      for (size_t j = 0; j < second_size; ++j) {
+        uint64_t cur = result[i + j] + first[i] * second[j] + carry;
+        result[i + j] = cur % base_;
+        carry = cur / base_;
+      }
+      result[i + second_size] = carry;
+    }
   }
-  size_t i = first.size();
-  do {
-    --i;
-    if (first.blocks_[i] < other.blocks_[i]) {
-      return true;
-    } else if (first.blocks_[i] != other.blocks_[i]) {
-      return false;
+  // result[0, first_size + second_size) must be zeroed and must not alias.
+  // Karatsuba above kKaratsubaLimbs; unbalanced operands are cut into
+  // pieces of the shorter length. At most threads threads, counting the
+  // caller, form the three half-size products of large operands, each
+  // writing its own part of the result, so the output is the same as
+  // sequentially. Exceptions from the branches reach the caller.
+  static void multiply_limbs(uint64_t* result, const uint64_t* first,
+                             size_t first_size, const uint64_t* second,
+                             size_t second_size, size_t threads = 1) {
+    if (first_size < second_size) {
+      std::swap(first, second);
+      std::swap(first_size, second_size);
     }
-  } while (i != 0);
-  return false;
-}
-bool operator>(const BigInteger& first, const BigInteger& other) {
-  return other < first;
-}
-bool operator>=(const BigInteger& first, const BigInteger& other) {
-  return !(first < other);
-}
-bool operator<=(const BigInteger& first, const BigInteger& other) {
-  return !(other < first);
-}
+    if (second_size == 1) {
+      result[first_size] =
+          short_mult_limbs(result, first, first_size, second[0]);
+      return;
+    }
+    bool square = first == second && first_size == second_size;
+    if (second_size < kKaratsubaLimbs) {
+      if (square) {
+        sqr_limbs(result, first, first_size);
+      } else {
+        mult_limbs(result, first, first_size, second, second_size);
+      }
+      return;
+    }
+    size_t half = (first_size + 1) / 2;
+    if (second_size <= half) {
+      LimbVector piece;
+      for (size_t shift = 0; shift < first_size; shift += second_size) {
+        size_t piece_size = std::min(second_size, first_size - shift);
+        piece.assign(piece_size + second_size, 0);
+        multiply_limbs(piece.data(), first + shift, piece_size, second,
+                       second_size, threads);
+        add_limbs(result + shift, result + shift,
+                  first_size + second_size - shift, piece.data(),
+                  piece.size());
+      }
+      return;
+    }
+    size_t high_first = first_size - half;
+    size_t high_second = second_size - half;
+    LimbVector first_sum(half + 1, 0);
+    first_sum[half] = add_limbs(first_sum.data(), first, half, first + half,
+                                high_first);
+    LimbVector second_sum;
+    if (!square) {
+      second_sum.assign(half + 1, 0);
+      second_sum[half] = add_limbs(second_sum.data(), second, half,
+                                   second + half, high_second);
+    }
+    const uint64_t* second_sum_data =
+        square ? first_sum.data() : second_sum.data();
+    LimbVector middle(2 * half + 2, 0);
+    auto low_product = [&](size_t count) {
+      multiply_limbs(result, first, half, second, half, count);
+    };
+    auto high_product = [&](size_t count) {
+      multiply_limbs(result + 2 * half, first + half, high_first,
+                     second + half, high_second, count);
+    };
+    auto middle_product = [&](size_t count) {
+      multiply_limbs(middle.data(), first_sum.data(), half + 1,
+                     second_sum_data, half + 1, count);
+    };
+    if (threads > 1 && second_size >= kParallelMultiplyLimbs) {
+      // Two threads run the high branch apart and the other two inline.
+      size_t share = std::max<size_t>(threads / 3, 1);
+      auto high_branch = std::async(std::launch::async, high_product, share);
+      if (threads >= 3) {
+        auto middle_branch =
+            std::async(std::launch::async, middle_product, share);
+        low_product(threads - 2 * share);
+        middle_branch.get();
+      } else {
+        low_product(1);
+        middle_product(1);
+      }
+      high_branch.get();
+    } else {
+      low_product(1);
+      high_product(1);
+      middle_product(1);
+    }
+    size_t high_size = high_first + high_second;
+    sub_limbs(middle.data(), middle.data(), middle.size(), result, 2 * half);
+    sub_limbs(middle.data(), middle.data(), middle.size(), result + 2 * half,
+              high_size);
+    size_t middle_size = middle.size();
+    while (middle_size > 0 && middle[middle_size - 1] == 0) {
+      --middle_size;
+    }
+    add_limbs(result + half, result + half, first_size + second_size - half,
+              middle.data(), middle_size);
+  }
+  // The two limbs below position `length` as one number, e.g. the leading
+  // digits of an operand of `length` limbs.
+  uint64_t leading_limbs(size_t length) const {
+    uint64_t high = length - 1 < size() ? blocks_[length - 1] : 0;
+    uint64_t low = length >= 2 && length - 2 < size() ? blocks_[length - 2] : 0;
+    return high * base_ + low;
+  }
+  BigInteger high_limbs(size_t shift) const {
+    BigInteger result;
+    if (shift < size()) {
+      result.blocks_.assign(blocks_.begin() + shift, blocks_.end());
+    }
+    return result;
+  }
+  // (first, second) = (a * first + b * second, c * first + d * second) in
+  // place, for |a|, |b|, |c|, |d| < 2^31 and non-negative results, as given
+  // by a certified Lehmer quotient sequence.
+  static void combine_pair(BigInteger& first, BigInteger& second, int64_t a,
+                           int64_t b, int64_t c, int64_t d) {
+    size_t length = std::max(first.size(), second.size());
+    first.blocks_.resize(length, 0);
+    second.blocks_.resize(length, 0);
+    int64_t first_carry = 0;
+    int64_t second_carry = 0;
+    for (size_t i = 0; i < length; ++i) {
+      int64_t first_limb = first.blocks_[i];
+      int64_t second_limb = second.blocks_[i];
+      first.blocks_[i] =
+          floor_limb(a * first_limb + b * second_limb + first_carry,
+                     first_carry);
+      second.blocks_[i] =
+          floor_limb(c * first_limb + d * second_limb + second_carry,
+                     second_carry);
+    }
+    for (; first_carry > 0; first_carry /= base_) {
+      first.blocks_.push_back(first_carry % base_);
+    }
+    for (; second_carry > 0; second_carry /= base_) {
+      second.blocks_.push_back(second_carry % base_);
+    }
+    first.check_zeroes();
+    second.check_zeroes();
+  }
+  // Splits value into a limb in [0, base_) and a floored carry.
+  static uint64_t floor_limb(int64_t value, int64_t& carry) {
+    carry = value / base_;
+    value %= base_;
+    if (value < 0) {
+      value += base_;
+      --carry;
+    }
+    return value;
+  }
+  // result[0, 2 * size) must be zeroed and must not alias value. Each cross
+  // product is taken once and doubled, about half the work of mult_limbs.
+  static void sqr_limbs(uint64_t* result, const uint64_t* value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      uint64_t carry = 0;
+      for (size_t j = i + 1; j < size; ++j) {
+        uint64_t cur = result[i + j] + value[i] * value[j] + carry;
+        result[i + j] = cur % base_;
+        carry = cur / base_;
+      }
+      result[i + size] = carry;
+    }
+    uint64_t carry = 0;
+    for (size_t i = 0; i < size; ++i) {
+      uint64_t square = value[i] * value[i];
+      uint64_t cur = 2 * result[2 * i] + square % base_ + carry;
+      result[2 * i] = cur % base_;
+      carry = cur / base_;
+      cur = 2 * result[2 * i + 1] + square / base_ + carry;
+      result[2 * i + 1] = cur % base_;
+      carry = cur / base_;
+    }
+  }
+  // *this = first * second; neither operand may alias *this. One spare limb
+  // is reserved so that adding to the product rarely has to grow it.
+  void assign_product(const BigInteger& first, const BigInteger& second,
+                      size_t threads) {
+    if (first.size() == 1 && second.size() == 1) {
+      set_small(first.small_value() * second.small_value());
+      return;
+    }
+    if (first.is_zero() || second.is_zero()) {
+      set_small(0);
+      return;
+    }
+    blocks_.assign(first.size() + second.size() + 1, 0);
+    multiply_limbs(blocks_.data(), first.blocks_.data(), first.size(),
+                   second.blocks_.data(), second.size(), threads);
+    sign_ = (first.sign_ == second.sign_);
+    check_zeroes();
+  }
+  // |*this| += |other|.
+  void add_abs(const BigInteger& other) {
+    size_t other_size = other.size();
+    if (size() < other_size) {
+      blocks_.resize(other_size, 0);
+    }
+    uint64_t carry = add_limbs(blocks_.data(), blocks_.data(), size(),
+                               other.blocks_.data(), other_size);
+    if (carry != 0) {
+      blocks_.push_back(carry);
+    }
+  }
+  // |*this| = ||*this| - |other||; returns true if |other| was the larger.
+  bool sub_abs(const BigInteger& other) {
+    size_t own_size = size();
+    if (compare_limbs(blocks_.data(), own_size, other.blocks_.data(),
+                      other.size()) >= 0) {
+      sub_limbs(blocks_.data(), blocks_.data(), own_size,
+                other.blocks_.data(), other.size());
+      return false;
+    }
+    blocks_.resize(other.size(), 0);
+    sub_limbs(blocks_.data(), other.blocks_.data(), other.size(),
+              blocks_.data(), own_size);
+    return true;
+  }
+  // Truncating *this /= value in place; returns the remainder, which has
+  // the sign of the dividend.
+  int64_t short_div(int64_t value) {
+    if (value == 0) {
+      throw std::overflow_error("Divide by zero exception");
+    }
+    bool sign_remainder = sign_;
+    sign_ = (sign_ == (value > 0));
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value)
+                                   : static_cast<uint64_t>(value);
+    int64_t remainder = static_cast<int64_t>(short_div_abs(magnitude));
+    return sign_remainder ? remainder : -remainder;
+  }
+  void short_mult(int64_t value) {
+    if ((is_negative() && value < 0) || (!is_negative() && value >= 0)) {
+      sign_ = true;
+    } else {
+      sign_ = false;
+    }
+    if (value == 0) {
+      set_small(0);
+      return;
+    }
+    uint64_t carry = short_mult_limbs(blocks_.data(), blocks_.data(), size(),
+                                      std::abs(value));
+    if (carry != 0) {
+      blocks_.push_back(carry);
+    }
+  }
+  uint64_t short_div_abs(uint64_t value) {
+    uint64_t remainder = short_div_limbs(blocks_.data(), blocks_.data(),
+                                         size(), InvariantDivisor(value));
+    check_zeroes();
+    return remainder;
+  }
+  // result[0, size) = value / divisor, returns value % divisor; result may
+  // alias value or be null when only the remainder is needed. The running
+  // remainder is kept scaled by the divisor's normalization shift, and each
+  // step divides remainder * base_ + limb, which is below divisor * 2^64.
+  static uint64_t short_div_limbs(uint64_t* result, const uint64_t* value,
+                                  size_t size,
+                                  const InvariantDivisor& divisor) {
+    uint64_t remainder = 0;
+    for (size_t i = size; i != 0; --i) {
+      unsigned __int128 current =
+          static_cast<unsigned __int128>(remainder) * base_ +
+          (static_cast<unsigned __int128>(value[i - 1]) << divisor.shift());
+      uint64_t quotient =
+          divisor.divide(static_cast<uint64_t>(current >> 64),
+                         static_cast<uint64_t>(current), remainder);
+      if (result != nullptr) {
+        result[i - 1] = quotient;
+      }
+    }
+    return remainder >> divisor.shift();
+  }
+  // Knuth's algorithm D over base_ limbs: replaces |*this| with the quotient
+  // |*this| / |other| and stores the remainder if asked for.
+  void divide_abs(const BigInteger& other, BigInteger* remainder) {
+    if (other.is_zero()) {
+      throw std::overflow_error("Divide by zero exception");
+    }
+    sign_ = true;
+    if (abs_lower(other)) {
+      if (remainder != nullptr) {
+        *remainder = *this;
+      }
+      *this = 0;
+      return;
+    }
+    if (other.size() == 1) {
+      uint64_t rest = short_div_abs(other.blocks_[0]);
+      if (remainder != nullptr) {
+        *remainder = static_cast<int64_t>(rest);
+      }
+      return;
+    }
+    const size_t n = other.size();
+    const size_t m = size() - n;
+    const uint64_t factor = base_ / (other.blocks_[n - 1] + 1);
+    BigInteger divisor(other, true);
+    divisor.short_mult(factor);
+    short_mult(factor);
+    blocks_.resize(m + n + 1, 0);
+    LimbVector& u = blocks_;
+    const LimbVector& v = divisor.blocks_;
+    LimbVector quotient(m + 1, 0);
+    for (size_t j = m + 1; j-- != 0;) {
+      uint64_t numerator = u[j + n] * base_ + u[j + n - 1];
+      uint64_t qhat = numerator / v[n - 1];
+      uint64_t rhat = numerator % v[n - 1];
+      while (qhat >= static_cast<uint64_t>(base_) ||
+             qhat * v[n - 2] > rhat * base_ + u[j + n - 2]) {
+        --qhat;
+        rhat += v[n - 1];
+        if (rhat >= static_cast<uint64_t>(base_)) {
+          break;
+        }
+      }
+      int64_t borrow = 0;
+      uint64_t carry = 0;
+      for (size_t i = 0; i < n; ++i) {
+        uint64_t product = qhat * v[i] + carry;
+        carry = product / base_;
+        int64_t cur = static_cast<int64_t>(u[i + j]) -
+                      static_cast<int64_t>(product % base_) + borrow;
+        borrow = cur < 0 ? -1 : 0;
+        u[i + j] = cur < 0 ? cur + base_ : cur;
+      }
+      int64_t top = static_cast<int64_t>(u[j + n]) -
+                    static_cast<int64_t>(carry) + borrow;
+      if (top < 0) {
+        --qhat;
+        carry = 0;
+        for (size_t i = 0; i < n; ++i) {
+          uint64_t sum = u[i + j] + v[i] + carry;
+          carry = sum >= static_cast<uint64_t>(base_) ? 1 : 0;
+          u[i + j] = sum - carry * base_;
+        }
+        top += carry;
+      }
+      u[j + n] = top;
+      quotient[j] = qhat;
+    }
+    if (remainder != nullptr) {
+      remainder->sign_ = true;
+      remainder->blocks_.assign(u.begin(), u.begin() + n);
+      remainder->check_zeroes();
+      remainder->short_div_abs(factor);
+    }
+    blocks_ = std::move(quotient);
+    check_zeroes();
+  }
+  bool abs_lower(const BigInteger& other) const {
+    return compare_abs(other) < 0;
+  }
+  static const int64_t base_ = 1000000000;
+  static const size_t base_power_ = 9;
+  static size_t concurrency_;
+  static SimdLevel simd_level_;
+  bool sign_ = true;  // true <-> non-negative; false <-> negative
+  LimbVector blocks_;
+};
+
+size_t BigInteger::concurrency_ =
+    std::max(1u, std::thread::hardware_concurrency());
+SimdLevel BigInteger::simd_level_ = detect_simd_level();
+
+bool operator==(const BigInteger& first, const BigInteger& other) {
+  if (first.size() != other.size() || first.sign() != other.sign()) {
+    return false;
+  }
+  return first.blocks_ == other.blocks_;
+}
+bool operator!=(const BigInteger& first, const BigInteger& other) {
+  return !(first == other);
+}
+bool operator<(const BigInteger& first, const BigInteger& other) {
+  return first.compare(other) < 0;
+}
+bool operator>(const BigInteger& first, const BigInteger& other) {
+  return other < first;
+}
+bool operator>=(const BigInteger& first, const BigInteger& other) {
+  return !(first < other);
+}
+bool operator<=(const BigInteger& first, const BigInteger& other) {
+  return !(other < first);
+}
+#ifdef __cpp_impl_three_way_comparison
+std::strong_ordering operator<=>(const BigInteger& first,
+                                 const BigInteger& other) {
+  return first.compare(other) <=> 0;
+}
+#endif
 
 BigInteger operator+(const BigInteger& first, const BigInteger& second) {
   BigInteger tmp(first);
   return tmp += second;
 }
+BigInteger operator+(BigInteger&& first, const BigInteger& second) {
+  return std::move(first += second);
+}
+BigInteger operator+(const BigInteger& first, BigInteger&& second) {
+  return std::move(second += first);
+}
+BigInteger operator+(BigInteger&& first, BigInteger&& second) {
+  return std::move(first += second);
+}
 
 BigInteger operator-(const BigInteger& first, const BigInteger& second) {
   BigInteger tmp(first);
   return tmp -= second;
 }
+BigInteger operator-(BigInteger&& first, const BigInteger& second) {
+  return std::move(first -= second);
+}
+BigInteger operator-(const BigInteger& first, BigInteger&& second) {
+  second -= first;
+  second.change_sign();
+  return std::move(second);
+}
+BigInteger operator-(BigInteger&& first, BigInteger&& second) {
+  return std::move(first -= second);
+}
 
 BigInteger operator*(const BigInteger& first, const BigInteger& second) {
-  BigInteger tmp(first);
-  return tmp *= second;
+  BigInteger result;
+  result.assign_product(first, second, BigInteger::concurrency_);
+  return result;
+}
+// first * second on at most threads threads (and at most concurrency()).
+BigInteger multiply(const BigInteger& first, const BigInteger& second,
+                    size_t threads) {
+  BigInteger result;
+  result.assign_product(
+      first, second,
+      std::max<size_t>(std::min(threads, BigInteger::concurrency_), 1));
+  return result;
+}
+BigInteger operator*(BigInteger&& first, const BigInteger& second) {
+  return std::move(first *= second);
+}
+BigInteger operator*(const BigInteger& first, BigInteger&& second) {
+  return std::move(second *= first);
+}
+BigInteger operator*(BigInteger&& first, BigInteger&& second) {
+  return std::move(first *= second);
 }
 
 BigInteger operator/(const BigInteger& first, const BigInteger& second) {
   BigInteger tmp(first);
   return tmp /= second;
 }
+BigInteger operator/(BigInteger&& first, const BigInteger& second) {
+  return std::move(first /= second);
+}
+
+void divmod(const BigInteger& first, const BigInteger& second,
+            BigInteger& quotient, BigInteger& remainder) {
+  bool sign_result = (first.sign_ == second.sign_);
+  bool sign_remainder = first.sign_;
+  quotient = first;
+  quotient.divide_abs(second, &remainder);
+  quotient.sign_ = sign_result || quotient.is_zero();
+  remainder.sign_ = sign_remainder || remainder.is_zero();
+}
 
 BigInteger& operator%=(BigInteger& first, const BigInteger& second) {
-  return first -= (first / second) * second;
+  BigInteger quotient;
+  divmod(first, second, quotient, first);
+  return first;
 }
 
 BigInteger operator%(const BigInteger& first, const BigInteger& second) {
@@ -527,6 +1554,36 @@ BigInteger operator%(const BigInteger& first, const BigInteger& second) {
   return tmp %= second;
 }
 
+// Division by a machine word, through InvariantDivisor; the remainder has
+// the sign of the dividend, as in divmod.
+void divmod_small(const BigInteger& first, int64_t second,
+                  BigInteger& quotient, int64_t& remainder) {
+  quotient = first;
+  remainder = quotient.short_div(second);
+}
+
+BigInteger operator/(const BigInteger& first, int64_t second) {
+  BigInteger tmp(first);
+  return tmp /= second;
+}
+BigInteger operator/(BigInteger&& first, int64_t second) {
+  return std::move(first /= second);
+}
+
+int64_t operator%(const BigInteger& first, int64_t second) {
+  if (second == 0) {
+    throw std::overflow_error("Divide by zero exception");
+  }
+  uint64_t magnitude = second < 0 ? 0 - static_cast<uint64_t>(second)
+                                  : static_cast<uint64_t>(second);
+  int64_t remainder = static_cast<int64_t>(first.abs_mod(magnitude));
+  return first.is_negative() ? -remainder : remainder;
+}
+
+BigInteger& operator%=(BigInteger& first, int64_t second) {
+  return first = first % second;
+}
+
 std::ostream& operator<<(std::ostream& out, const BigInteger& value) {
   out << value.toString();
   return out;
@@ -541,22 +1598,384 @@ std::istream& operator>>(std::istream& in, BigInteger& value) {
 
 BigInteger operator""_bi(unsigned long long value) { return BigInteger(value); }
 
+// Cofactor matrix [a b; c d] of a Euclidean reduction: it maps the starting
+// pair (first, second) to the current one.
+struct GcdMatrix {
+  BigInteger a = 1;
+  BigInteger b = 0;
+  BigInteger c = 0;
+  BigInteger d = 1;
+  bool is_identity() const { return a == 1 && b == 0 && c == 0 && d == 1; }
+  // Left-multiplies by [x y; z w].
+  void apply(const BigInteger& x, const BigInteger& y, const BigInteger& z,
+             const BigInteger& w) {
+    BigInteger new_a = x * a + y * c;
+    BigInteger new_b = x * b + y * d;
+    c = z * a + w * c;
+    d = z * b + w * d;
+    a = std::move(new_a);
+    b = std::move(new_b);
+  }
+  void swap_rows() {
+    std::swap(a, c);
+    std::swap(b, d);
+  }
+};
+
+// Operand size (in limbs) from which euclid_reduce switches to half-gcd
+// steps when it tracks cofactors, and when it does not. Applying the
+// cofactor matrix costs a few Karatsuba multiplications, which plain Lehmer
+// passes without cofactors only lose to on much larger operands.
+const size_t kHalfGcdLimbs = 1 << 9;
+const size_t kPlainHalfGcdLimbs = 1 << 13;
+
+// One Euclidean division step on first >= second > 0.
+void euclid_division_step(BigInteger& first, BigInteger& second,
+                          GcdMatrix* matrix) {
+  BigInteger quotient;
+  BigInteger remainder;
+  divmod(first, second, quotient, remainder);
+  first = std::move(second);
+  second = std::move(remainder);
+  if (matrix != nullptr) {
+    matrix->apply(0, 1, 1, -quotient);
+  }
+}
+
+// Lehmer's step: runs Euclid on the leading two limbs of both operands and
+// returns false if no single-word quotient could be certified.
+bool lehmer_step(BigInteger& first, BigInteger& second, GcdMatrix* matrix) {
+  const int64_t limit = int64_t(1) << 31;
+  size_t length = first.size();
+  int64_t first_top = first.leading_limbs(length);
+  int64_t second_top = second.leading_limbs(length);
+  int64_t a = 1;
+  int64_t b = 0;
+  int64_t c = 0;
+  int64_t d = 1;
+  while (second_top + c > 0 && second_top + d > 0) {
+    int64_t quotient = (first_top + a) / (second_top + c);
+    if (quotient != (first_top + b) / (second_top + d) || quotient > limit) {
+      break;
+    }
+    int64_t next_c = a - quotient * c;
+    int64_t next_d = b - quotient * d;
+    if (next_c > limit || next_c < -limit || next_d > limit ||
+        next_d < -limit) {
+      break;
+    }
+    a = c;
+    c = next_c;
+    b = d;
+    d = next_d;
+    int64_t next_top = first_top - quotient * second_top;
+    first_top = second_top;
+    second_top = next_top;
+  }
+  if (b == 0) {
+    return false;
+  }
+  BigInteger::combine_pair(first, second, a, b, c, d);
+  if (matrix != nullptr) {
+    matrix->apply(a, b, c, d);
+  }
+  return true;
+}
+
+// Reduces first >= second >= 0 by Euclidean steps until second has at most
+// stop_size limbs (or is zero), recording the cofactors in matrix if given.
+// Large operands go through a half-gcd step: the reduction matrix of their
+// top halves is computed recursively and applied to the full values at once.
+void euclid_reduce(BigInteger& first, BigInteger& second, GcdMatrix* matrix,
+                   size_t stop_size) {
+  bool allow_half_gcd = true;
+  while (!second.is_zero() && second.size() > stop_size) {
+    size_t half_gcd_limbs =
+        matrix == nullptr ? kPlainHalfGcdLimbs : kHalfGcdLimbs;
+    if (allow_half_gcd && first.size() >= half_gcd_limbs &&
+        second.size() + 1 >= first.size()) {
+      size_t old_size = first.size();
+      size_t shift = old_size / 2;
+      BigInteger top_first = first.high_limbs(shift);
+      BigInteger top_second = second.high_limbs(shift);
+      GcdMatrix inner;
+      euclid_reduce(top_first, top_second, &inner, (old_size - shift) / 2);
+      if (!inner.is_identity()) {
+        BigInteger new_first = inner.a * first + inner.b * second;
+        second = inner.c * first + inner.d * second;
+        first = std::move(new_first);
+        if (first.is_negative()) {
+          first.change_sign();
+          inner.apply(-1, 0, 0, 1);
+        }
+        if (second.is_negative()) {
+          second.change_sign();
+          inner.apply(1, 0, 0, -1);
+        }
+        if (first < second) {
+          std::swap(first, second);
+          inner.swap_rows();
+        }
+        if (matrix != nullptr) {
+          matrix->apply(inner.a, inner.b, inner.c, inner.d);
+        }
+        allow_half_gcd = first.size() < old_size;
+        continue;
+      }
+    }
+    allow_half_gcd = true;
+    if (matrix == nullptr && first.size() <= 2) {
+      uint64_t first_word = first.leading_limbs(2);
+      uint64_t second_word = second.leading_limbs(2);
+      while (second_word != 0) {
+        first_word %= second_word;
+        std::swap(first_word, second_word);
+      }
+      first = BigInteger(static_cast<int64_t>(first_word));
+      second = 0;
+      return;
+    }
+    if (first.size() > second.size() + 1 ||
+        !lehmer_step(first, second, matrix)) {
+      euclid_division_step(first, second, matrix);
+    }
+  }
+}
+
 BigInteger gcd(const BigInteger& first, const BigInteger& second) {
   BigInteger gcd1(first, true);
   BigInteger gcd2(second, true);
-  while (gcd1 != 0 && gcd2 != 0) {
-    if (gcd1 > gcd2) {
-      gcd1 %= gcd2;
+  if (gcd1 < gcd2) {
+    std::swap(gcd1, gcd2);
+  }
+  euclid_reduce(gcd1, gcd2, nullptr, 0);
+  return gcd1;
+}
+
+// Returns g = gcd(first, second) and sets the Bezout coefficients so that
+// first * first_factor + second * second_factor == g.
+BigInteger gcd_extended(const BigInteger& first, const BigInteger& second,
+                        BigInteger& first_factor, BigInteger& second_factor) {
+  BigInteger gcd1(first, true);
+  BigInteger gcd2(second, true);
+  GcdMatrix matrix;
+  bool swapped = gcd1 < gcd2;
+  if (swapped) {
+    std::swap(gcd1, gcd2);
+  }
+  euclid_reduce(gcd1, gcd2, &matrix, 0);
+  first_factor = swapped ? matrix.b : matrix.a;
+  second_factor = swapped ? matrix.a : matrix.b;
+  if (first.is_negative()) {
+    first_factor.change_sign();
+  }
+  if (second.is_negative()) {
+    second_factor.change_sign();
+  }
+  return gcd1;
+}
+
+// Sums many terms without carry propagation: every limb is a signed 64-bit
+// sum of term limbs (each below 2^30), so 2^32 terms can be added before
+// any limb may overflow. Carries are only resolved by value() or when that
+// many terms are pending.
+class BigIntegerAccumulator {
+ public:
+  BigIntegerAccumulator() = default;
+  explicit BigIntegerAccumulator(const BigInteger& value) { *this += value; }
+  BigIntegerAccumulator& operator+=(const BigInteger& term) {
+    accumulate(term.blocks_.data(), term.size(), term.is_negative());
+    return *this;
+  }
+  BigIntegerAccumulator& operator-=(const BigInteger& term) {
+    accumulate(term.blocks_.data(), term.size(), !term.is_negative());
+    return *this;
+  }
+  // Adds first * second without building the product as a BigInteger.
+  void add_product(const BigInteger& first, const BigInteger& second) {
+    if (first.is_zero() || second.is_zero()) {
+      return;
+    }
+    product_.assign(first.size() + second.size(), 0);
+    BigInteger::multiply_limbs(product_.data(), first.blocks_.data(),
+                               first.size(), second.blocks_.data(),
+                               second.size());
+    size_t size = product_.size();
+    if (product_[size - 1] == 0) {
+      --size;
+    }
+    accumulate(product_.data(), size,
+               first.is_negative() != second.is_negative());
+  }
+  BigInteger value() {
+    normalize();
+    BigInteger result;
+    bool negative = !limbs_.empty() && static_cast<int64_t>(limbs_.back()) < 0;
+    if (negative) {
+      for (uint64_t& limb : limbs_) {
+        limb = 0 - limb;
+      }
+      normalize();
+    }
+    size_t size = limbs_.size();
+    while (size != 0 && limbs_[size - 1] == 0) {
+      --size;
+    }
+    if (size == 0) {
+      return result;
+    }
+    result.blocks_.assign(limbs_.data(), limbs_.data() + size);
+    result.sign_ = !negative;
+    if (negative) {
+      for (uint64_t& limb : limbs_) {
+        limb = 0 - limb;
+      }
+    }
+    return result;
+  }
+  void clear() {
+    limbs_.clear();
+    pending_ = 0;
+  }
+
+ private:
+  static const uint64_t kMaxPending = uint64_t(1) << 32;
+
+  void accumulate(const uint64_t* term, size_t size, bool subtract) {
+    if (size > limbs_.size()) {
+      limbs_.resize(size, 0);
+    }
+    size_t i = 0;
+#ifdef BIGINTEGER_X86_SIMD
+    if (size >= kSimdLimbs && BigInteger::simd_level() == SimdLevel::kAvx512) {
+      i = accumulate_avx512(limbs_.data(), term, size, subtract);
+    } else if (size >= kSimdLimbs &&
+               BigInteger::simd_level() == SimdLevel::kAvx2) {
+      i = accumulate_avx2(limbs_.data(), term, size, subtract);
+    }
+#endif
+    if (subtract) {
+      for (; i < size; ++i) {
+        limbs_[i] -= term[i];
+      }
     } else {
-      gcd2 %= gcd1;
+      for (; i < size; ++i) {
+        limbs_[i] += term[i];
+      }
+    }
+    if (++pending_ == kMaxPending) {
+      normalize();
+    }
+  }
+  // Brings every limb into [0, base) except the top one, which may be
+  // negative when the sum is; limbs are appended for an outgoing carry.
+  void normalize() {
+    const int64_t base = BigInteger::base_;
+    int64_t carry = 0;
+    auto split = [base](int64_t value, int64_t& high) {
+      int64_t low = value % base;
+      high = value / base;
+      if (low < 0) {
+        low += base;
+        --high;
+      }
+      return static_cast<uint64_t>(low);
+    };
+    for (uint64_t& limb : limbs_) {
+      limb = split(static_cast<int64_t>(limb) + carry, carry);
+    }
+    while (carry <= -base || carry >= base) {
+      limbs_.push_back(split(carry, carry));
+    }
+    if (carry != 0) {
+      limbs_.push_back(static_cast<uint64_t>(carry));
     }
+    pending_ = 0;
   }
-  if (gcd1 != 0) {
-    return gcd1;
+#ifdef BIGINTEGER_X86_SIMD
+  __attribute__((target("avx2"))) static size_t accumulate_avx2(
+      uint64_t* limbs, const uint64_t* term, size_t size, bool subtract) {
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+      __m256i* target = reinterpret_cast<__m256i*>(limbs + i);
+      __m256i value =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(term + i));
+      __m256i sum = _mm256_loadu_si256(target);
+      sum = subtract ? _mm256_sub_epi64(sum, value)
+                     : _mm256_add_epi64(sum, value);
+      _mm256_storeu_si256(target, sum);
+    }
+    return i;
+  }
+  __attribute__((target("avx512f"))) static size_t accumulate_avx512(
+      uint64_t* limbs, const uint64_t* term, size_t size, bool subtract) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      __m512i value = _mm512_loadu_si512(term + i);
+      __m512i sum = _mm512_loadu_si512(limbs + i);
+      sum = subtract ? _mm512_sub_epi64(sum, value)
+                     : _mm512_add_epi64(sum, value);
+      _mm512_storeu_si512(limbs + i, sum);
+    }
+    return i;
+  }
+#endif
+
+  std::vector<uint64_t> limbs_;
+  LimbVector product_;
+  uint64_t pending_ = 0;
+};
+
+// |numerator| / |denominator| correctly rounded to a double: the quotient
+// is scaled by a power of two into [2^61, 2^64), divided exactly and rounded
+// with the remainder as the sticky bit. Long operands are first cut by the
+// same number of limbs to heads a / b; the exact quotient lies between
+// a / (b + 1) and (a + 1) / b, and when both round alike that is the result.
+double ratio_to_double(const BigInteger& numerator,
+                       const BigInteger& denominator) {
+  if (numerator.is_zero()) {
+    return 0.0;
+  }
+  double log2 = (numerator.log_abs() - denominator.log_abs()) / std::log(2.0);
+  if (log2 > 1025) {
+    return HUGE_VAL;
   }
-  return gcd2;
+  if (log2 < -1080) {
+    return 0.0;
+  }
+  size_t cut = std::min(numerator.size(), denominator.size());
+  if (cut > 16) {
+    BigInteger numerator_head = numerator.high_limbs(cut - 8);
+    BigInteger denominator_head = denominator.high_limbs(cut - 8);
+    double result = ratio_to_double(numerator_head, denominator_head + 1);
+    if (result == ratio_to_double(numerator_head + 1, denominator_head)) {
+      return result;
+    }
+  }
+  int64_t exponent = static_cast<int64_t>(std::floor(log2)) - 62;
+  BigInteger power = pow(BigInteger(2), exponent < 0 ? -exponent : exponent);
+  BigInteger scaled(numerator, true);
+  BigInteger divisor(denominator, true);
+  if (exponent < 0) {
+    scaled *= power;
+  } else {
+    divisor *= power;
+  }
+  BigInteger quotient;
+  BigInteger remainder;
+  divmod(scaled, divisor, quotient, remainder);
+  std::vector<uint32_t> words = quotient.binary_words();
+  words.resize(2, 0);
+  uint64_t mantissa = static_cast<uint64_t>(words[1]) << 32 | words[0];
+  return round_to_double(mantissa, !remainder.is_zero(), exponent);
 }
 
+// When Rational arithmetic brings results to lowest terms: after every
+// operation, never (only toString/asDecimal reduce), or once a numerator or
+// denominator reaches the configured number of limbs. The policy is global
+// and may be changed while other threads compute.
+enum class RationalNormalization { kAlways, kNever, kThreshold };
+
 class Rational {
  public:
   Rational() = default;
@@ -565,36 +1984,37 @@ class Rational {
   Rational(const BigInteger& numerator, const BigInteger& denominator = 1)
       : numerator_(numerator), denominator_(denominator) {
     change_sign();
+    reduced_ = denominator_ == 1;
+    normalize();
   }
   Rational(int64_t other) : numerator_(other) {}
   Rational& operator=(const Rational& other) = default;
+  static void set_normalization(RationalNormalization policy,
+                                size_t threshold_limbs = 4) {
+    normalization_.store(policy, std::memory_order_relaxed);
+    normalization_threshold_.store(threshold_limbs, std::memory_order_relaxed);
+  }
   Rational& operator+=(const Rational& other) {
-    numerator_ =
-        numerator_ * other.denominator_ + denominator_ * other.numerator_;
-    denominator_ *= other.denominator_;
-    change_sign();
+    add(other, false);
     return *this;
   }
   Rational& operator-=(const Rational& other) {
-    numerator_ =
-        numerator_ * other.denominator_ - denominator_ * other.numerator_;
-    denominator_ *= other.denominator_;
-    change_sign();
+    add(other, true);
     return *this;
   }
   Rational& operator*=(const Rational& other) {
-    numerator_ *= other.numerator_;
-    denominator_ *= other.denominator_;
-    change_sign();
+    multiply(other, false);
     return *this;
   }
   Rational& operator/=(const Rational& other) {
-    numerator_ *= other.denominator_;
-    denominator_ *= other.numerator_;
-    change_sign();
+    multiply(other, true);
     return *this;
   }
-  Rational operator-() const { return Rational(-numerator_, denominator_); }
+  Rational operator-() const {
+    Rational result(*this);
+    result.numerator_.change_sign();
+    return result;
+  }
   Rational operator+() const { return *this; }
   std::string toString() {
     reduce();
@@ -604,57 +2024,90 @@ class Rational {
       return numerator_.toString() + '/' + denominator_.toString();
     }
   }
+  // Rounded half away from zero to precision digits after the point.
   std::string asDecimal(size_t precision = 0) {
     reduce();
-    BigInteger tmp;
-    BigInteger new_numerator;
-    if (numerator_.is_negative()) {
-      tmp = -numerator_ / denominator_;
-      new_numerator = -numerator_ - tmp * denominator_;
-    } else {
-      tmp = numerator_ / denominator_;
-      new_numerator = numerator_ - tmp * denominator_;
-    }
-    std::string result;
-    if (numerator_.is_negative()) {
-      result.push_back('-');
-    }
-    result += tmp.toString();
-    if (precision == 0) {
-      return result;
+    BigInteger scaled(numerator_, true);
+    scaled.decimal_shift(precision);
+    BigInteger digits;
+    BigInteger remainder;
+    divmod(scaled, denominator_, digits, remainder);
+    if (remainder + remainder >= denominator_) {
+      ++digits;
     }
-    result.push_back('.');
-    for (size_t i = 0; i + 1 < precision; ++i) {
-      new_numerator *= 10;
-      tmp = new_numerator / denominator_;
-      if (tmp < 0) {
-        tmp.change_sign();
-      }
-      new_numerator -= tmp * denominator_;
-      result += tmp.toString();
+    bool negative = numerator_.is_negative() && !digits.is_zero();
+    std::string result = digits.toString();
+    if (result.size() <= precision) {
+      result.insert(0, precision + 1 - result.size(), '0');
     }
-    new_numerator *= 10;
-    tmp = new_numerator / denominator_;
-    new_numerator -= tmp * denominator_;
-    BigInteger next_tmp = new_numerator / denominator_;
-    if (next_tmp < 0) {
-      next_tmp.change_sign();
+    if (precision != 0) {
+      result.insert(result.end() - precision, '.');
     }
-    if (next_tmp >= 5) {
-      ++tmp;
+    if (negative) {
+      result.insert(result.begin(), '-');
     }
-    result += tmp.toString();
     return result;
   }
+  // Correctly rounded.
   explicit operator double() const {
-    return static_cast<double>(numerator_) / static_cast<double>(denominator_);
+    double result = ratio_to_double(numerator_, denominator_);
+    return numerator_.is_negative() ? -result : result;
+  }
+  // Three-way comparison. The cross products a * d and c * b of a / b and
+  // c / d are only formed when signs, equal denominators or numerators,
+  // operand lengths and a logarithm estimate all fail to decide.
+  int compare(const Rational& other) const {
+    auto signum = [](const BigInteger& value) {
+      return value.is_zero() ? 0 : value.is_negative() ? -1 : 1;
+    };
+    int sign = signum(numerator_);
+    int other_sign = signum(other.numerator_);
+    if (sign != other_sign || sign == 0) {
+      return sign < other_sign ? -1 : sign > other_sign ? 1 : 0;
+    }
+    if (denominator_.compare_abs(other.denominator_) == 0) {
+      return sign * numerator_.compare_abs(other.numerator_);
+    }
+    if (numerator_.compare_abs(other.numerator_) == 0) {
+      return sign * other.denominator_.compare_abs(denominator_);
+    }
+    // A product of x and y limbs has x + y - 1 or x + y limbs.
+    size_t left = numerator_.size() + other.denominator_.size();
+    size_t right = other.numerator_.size() + denominator_.size();
+    if (left + 1 < right) {
+      return -sign;
+    }
+    if (right + 1 < left) {
+      return sign;
+    }
+    if (left + right > 8) {
+      double left_log = numerator_.log_abs() + other.denominator_.log_abs();
+      double right_log = other.numerator_.log_abs() + denominator_.log_abs();
+      // log_abs reads two leading limbs, a relative error below 1e-9 each.
+      double error =
+          1e-8 + 1e-14 * (std::fabs(left_log) + std::fabs(right_log));
+      if (left_log + error < right_log) {
+        return -sign;
+      }
+      if (right_log + error < left_log) {
+        return sign;
+      }
+    }
+    return (numerator_ * other.denominator_).compare(other.numerator_ *
+                                                     denominator_);
   }
   friend bool operator==(const Rational& first, const Rational& other);
   friend bool operator<(const Rational& first, const Rational& other);
+  friend class RationalView;
+  friend class BigDecimal;
+  friend void serialize(const Rational& value, std::vector<uint8_t>& out);
 
  private:
   BigInteger numerator_ = 0;
   BigInteger denominator_ = 1;
+  bool reduced_ = true;  // known to be in lowest terms
+  static std::atomic<RationalNormalization> normalization_;
+  static std::atomic<size_t> normalization_threshold_;
   void change_sign() {
     if (denominator_.is_negative()) {
       denominator_.change_sign();
@@ -663,6 +2116,10 @@ class Rational {
   }
   void reduce() {
     change_sign();
+    if (reduced_) {
+      return;
+    }
+    reduced_ = true;
     if (numerator_ == 0) {
       denominator_ = 1;
       return;
@@ -675,24 +2132,127 @@ class Rational {
     denominator_ /= gcd_result;
     change_sign();
   }
-};
-
-bool operator==(const Rational& first, const Rational& other) {
-  return first.numerator_ * other.denominator_ ==
-         other.numerator_ * first.denominator_;
-}
-bool operator!=(const Rational& first, const Rational& other) {
-  return !(first == other);
-}
-bool operator<(const Rational& first, const Rational& other) {
-  if (first.numerator_.is_negative() && !other.numerator_.is_negative()) {
-    return true;
-  }
-  if (!first.numerator_.is_negative() && other.numerator_.is_negative()) {
-    return false;
+  size_t max_size() const {
+    return std::max(numerator_.size(), denominator_.size());
   }
-  return first.numerator_ * other.denominator_ <
-         other.numerator_ * first.denominator_;
+  void normalize() {
+    RationalNormalization policy =
+        normalization_.load(std::memory_order_relaxed);
+    if (reduced_ || policy == RationalNormalization::kNever) {
+      return;
+    }
+    size_t threshold = normalization_threshold_.load(std::memory_order_relaxed);
+    if (policy == RationalNormalization::kAlways || max_size() >= threshold) {
+      reduce();
+    }
+  }
+  bool use_gcd_forms(const Rational& other) const {
+    RationalNormalization policy =
+        normalization_.load(std::memory_order_relaxed);
+    if (policy == RationalNormalization::kThreshold) {
+      return std::max(max_size(), other.max_size()) >=
+             normalization_threshold_.load(std::memory_order_relaxed);
+    }
+    return policy == RationalNormalization::kAlways;
+  }
+  // Henrici's addition: with g = gcd(b, d) only gcd(a * d/g + c * b/g, g) can
+  // divide the sum, so reducing the operands first gives a reduced result.
+  void add(const Rational& other, bool subtract) {
+    if (&other == this) {
+      add(Rational(other), subtract);
+      return;
+    }
+    if (!use_gcd_forms(other)) {
+      BigInteger other_part = denominator_ * other.numerator_;
+      numerator_ *= other.denominator_;
+      subtract ? numerator_ -= other_part : numerator_ += other_part;
+      denominator_ *= other.denominator_;
+      reduced_ = denominator_ == 1;
+      normalize();
+      return;
+    }
+    if (!other.reduced_) {
+      Rational reduced_other(other);
+      reduced_other.reduce();
+      add(reduced_other, subtract);
+      return;
+    }
+    reduce();
+    BigInteger common = gcd(denominator_, other.denominator_);
+    bool trivial = common == 1;
+    BigInteger other_part =
+        other.numerator_ * (trivial ? denominator_ : denominator_ / common);
+    numerator_ *= trivial ? other.denominator_ : other.denominator_ / common;
+    subtract ? numerator_ -= other_part : numerator_ += other_part;
+    BigInteger common_rest = trivial ? common : gcd(numerator_, common);
+    if (!trivial) {
+      denominator_ /= common;
+    }
+    if (common_rest != 1) {
+      numerator_ /= common_rest;
+      denominator_ *= other.denominator_ / common_rest;
+    } else {
+      denominator_ *= other.denominator_;
+    }
+    if (numerator_.is_zero()) {
+      denominator_ = 1;
+    }
+    reduced_ = true;
+  }
+  // Multiplies by other (or by its inverse), cancelling gcd(a, d) and
+  // gcd(c, b) before the products.
+  void multiply(const Rational& other, bool inverse) {
+    if (&other == this) {
+      multiply(Rational(other), inverse);
+      return;
+    }
+    const BigInteger& numerator =
+        inverse ? other.denominator_ : other.numerator_;
+    const BigInteger& denominator =
+        inverse ? other.numerator_ : other.denominator_;
+    if (!use_gcd_forms(other) || numerator_.is_zero() || numerator.is_zero()) {
+      numerator_ *= numerator;
+      denominator_ *= denominator;
+      change_sign();
+      reduced_ = denominator_ == 1;
+      normalize();
+      return;
+    }
+    if (!other.reduced_) {
+      Rational reduced_other(other);
+      reduced_other.reduce();
+      multiply(reduced_other, inverse);
+      return;
+    }
+    reduce();
+    BigInteger first_common = gcd(numerator_, denominator);
+    BigInteger second_common = gcd(numerator, denominator_);
+    BigInteger new_numerator =
+        (numerator_ / first_common) * (numerator / second_common);
+    denominator_ =
+        (denominator_ / second_common) * (denominator / first_common);
+    numerator_ = std::move(new_numerator);
+    change_sign();
+    reduced_ = true;
+  }
+};
+
+std::atomic<RationalNormalization> Rational::normalization_(
+    RationalNormalization::kThreshold);
+std::atomic<size_t> Rational::normalization_threshold_(4);
+
+bool operator==(const Rational& first, const Rational& other) {
+  if (first.reduced_ && other.reduced_) {
+    return first.numerator_ == other.numerator_ &&
+           first.denominator_ == other.denominator_;
+  }
+  return first.compare(other) == 0;
+}
+bool operator!=(const Rational& first, const Rational& other) {
+  return !(first == other);
+}
+bool operator<(const Rational& first, const Rational& other) {
+  return first.compare(other) < 0;
 }
 bool operator>(const Rational& first, const Rational& other) {
   return other < first;
@@ -721,3 +2281,1495 @@ Rational operator/(const Rational& first, const Rational& second) {
   return tmp /= second;
 }
 
+// How BigDecimal drops digits: toward zero, away from zero, toward -inf or
+// +inf, or to the nearest value with ties away from zero, toward zero or to
+// an even last digit.
+enum class RoundingMode {
+  kDown,
+  kUp,
+  kFloor,
+  kCeiling,
+  kHalfUp,
+  kHalfDown,
+  kHalfEven
+};
+
+// Fixed-point decimal unscaled_ * 10^-scale_. Sums and products are exact;
+// division and set_scale round to a requested scale.
+class BigDecimal {
+ public:
+  BigDecimal() = default;
+  BigDecimal(int64_t value) : unscaled_(value) {}
+  BigDecimal(const BigInteger& unscaled, int32_t scale = 0)
+      : unscaled_(unscaled), scale_(scale) {}
+  // Accepts [-]digits[.digits].
+  explicit BigDecimal(const std::string& str) {
+    size_t point = str.find('.');
+    if (point == std::string::npos) {
+      unscaled_ = BigInteger(str);
+      return;
+    }
+    size_t fraction = str.size() - point - 1;
+    if (fraction > static_cast<size_t>(INT32_MAX)) {
+      throw std::invalid_argument("BigDecimal scale out of range");
+    }
+    unscaled_ = BigInteger(str.substr(0, point) + str.substr(point + 1));
+    scale_ = static_cast<int32_t>(fraction);
+  }
+  BigDecimal(const Rational& value, int32_t scale,
+             RoundingMode mode = RoundingMode::kHalfEven)
+      : unscaled_(value.numerator_), scale_(scale) {
+    BigInteger denominator = value.denominator_;
+    if (scale >= 0) {
+      unscaled_.decimal_shift(scale);
+    } else {
+      denominator.decimal_shift(-static_cast<int64_t>(scale));
+    }
+    divide_rounded(unscaled_, denominator, mode);
+  }
+  BigDecimal& operator=(const BigDecimal& other) = default;
+  const BigInteger& unscaled() const { return unscaled_; }
+  int32_t scale() const { return scale_; }
+  BigDecimal& operator+=(const BigDecimal& other) {
+    add(other, false);
+    return *this;
+  }
+  BigDecimal& operator-=(const BigDecimal& other) {
+    add(other, true);
+    return *this;
+  }
+  BigDecimal& operator*=(const BigDecimal& other) {
+    scale_ = checked_scale(static_cast<int64_t>(scale_) + other.scale_);
+    unscaled_ *= other.unscaled_;
+    return *this;
+  }
+  // *this / other rounded to `scale` fractional digits.
+  BigDecimal& divide(const BigDecimal& other, int32_t scale,
+                     RoundingMode mode = RoundingMode::kHalfEven) {
+    if (other.unscaled_.is_zero()) {
+      throw std::overflow_error("Divide by zero exception");
+    }
+    BigInteger divisor = other.unscaled_;
+    int64_t shift = static_cast<int64_t>(scale) - scale_ + other.scale_;
+    if (shift >= 0) {
+      unscaled_.decimal_shift(shift);
+    } else {
+      divisor.decimal_shift(-shift);
+    }
+    divide_rounded(unscaled_, divisor, mode);
+    scale_ = scale;
+    return *this;
+  }
+  BigDecimal& set_scale(int32_t scale,
+                        RoundingMode mode = RoundingMode::kHalfEven) {
+    int64_t drop = static_cast<int64_t>(scale_) - scale;
+    if (drop <= 0) {
+      unscaled_.decimal_shift(-drop);
+    } else if (drop < 19) {
+      int64_t divisor = 1;
+      for (int64_t i = 0; i < drop; ++i) {
+        divisor *= 10;
+      }
+      bool negative = unscaled_.is_negative();
+      BigInteger quotient;
+      int64_t remainder;
+      divmod_small(unscaled_, divisor, quotient, remainder);
+      unscaled_ = std::move(quotient);
+      int64_t twice = 2 * (remainder < 0 ? -remainder : remainder);
+      int half = twice < divisor ? -1 : twice > divisor ? 1 : 0;
+      round_quotient(unscaled_, remainder != 0, half, negative, mode);
+    } else {
+      BigInteger divisor = 1;
+      divisor.decimal_shift(drop);
+      divide_rounded(unscaled_, divisor, mode);
+    }
+    scale_ = scale;
+    return *this;
+  }
+  int compare(const BigDecimal& other) const {
+    if (scale_ == other.scale_) {
+      return unscaled_.compare(other.unscaled_);
+    }
+    auto signum = [](const BigInteger& value) {
+      return value.is_zero() ? 0 : value.is_negative() ? -1 : 1;
+    };
+    int sign = signum(unscaled_);
+    int other_sign = signum(other.unscaled_);
+    if (sign != other_sign || sign == 0) {
+      return sign < other_sign ? -1 : sign > other_sign ? 1 : 0;
+    }
+    if (scale_ < other.scale_) {
+      BigInteger aligned = unscaled_;
+      aligned.decimal_shift(static_cast<int64_t>(other.scale_) - scale_);
+      return aligned.compare(other.unscaled_);
+    }
+    BigInteger aligned = other.unscaled_;
+    aligned.decimal_shift(static_cast<int64_t>(scale_) - other.scale_);
+    return unscaled_.compare(aligned);
+  }
+  std::string toString() const {
+    std::string digits = unscaled_.toString();
+    bool negative = unscaled_.is_negative();
+    if (negative) {
+      digits.erase(digits.begin());
+    }
+    if (scale_ <= 0) {
+      if (!unscaled_.is_zero()) {
+        digits.append(-static_cast<int64_t>(scale_), '0');
+      }
+    } else {
+      size_t scale = static_cast<size_t>(scale_);
+      if (digits.size() <= scale) {
+        digits.insert(0, scale + 1 - digits.size(), '0');
+      }
+      digits.insert(digits.end() - scale, '.');
+    }
+    if (negative) {
+      digits.insert(digits.begin(), '-');
+    }
+    return digits;
+  }
+  explicit operator Rational() const {
+    BigInteger power = 1;
+    if (scale_ >= 0) {
+      power.decimal_shift(scale_);
+      return Rational(unscaled_, power);
+    }
+    power.decimal_shift(-static_cast<int64_t>(scale_));
+    return Rational(unscaled_ * power);
+  }
+
+ private:
+  BigInteger unscaled_ = 0;
+  int32_t scale_ = 0;
+  static int32_t checked_scale(int64_t scale) {
+    if (scale < INT32_MIN || scale > INT32_MAX) {
+      throw std::overflow_error("BigDecimal scale overflow");
+    }
+    return static_cast<int32_t>(scale);
+  }
+  void add(const BigDecimal& other, bool subtract) {
+    if (scale_ < other.scale_) {
+      unscaled_.decimal_shift(static_cast<int64_t>(other.scale_) - scale_);
+      scale_ = other.scale_;
+    }
+    BigInteger aligned;
+    const BigInteger* term = &other.unscaled_;
+    if (scale_ > other.scale_) {
+      aligned = other.unscaled_;
+      aligned.decimal_shift(static_cast<int64_t>(scale_) - other.scale_);
+      term = &aligned;
+    }
+    if (subtract) {
+      unscaled_ -= *term;
+    } else {
+      unscaled_ += *term;
+    }
+  }
+  // quotient is the exact result truncated toward zero; half compares the
+  // dropped part with one half unit.
+  static void round_quotient(BigInteger& quotient, bool inexact, int half,
+                             bool negative, RoundingMode mode) {
+    if (!inexact) {
+      return;
+    }
+    bool away = false;
+    switch (mode) {
+      case RoundingMode::kDown:
+        break;
+      case RoundingMode::kUp:
+        away = true;
+        break;
+      case RoundingMode::kFloor:
+        away = negative;
+        break;
+      case RoundingMode::kCeiling:
+        away = !negative;
+        break;
+      case RoundingMode::kHalfUp:
+        away = half >= 0;
+        break;
+      case RoundingMode::kHalfDown:
+        away = half > 0;
+        break;
+      case RoundingMode::kHalfEven:
+        away = half > 0 || (half == 0 && quotient.is_odd());
+        break;
+    }
+    if (away && negative) {
+      --quotient;
+    } else if (away) {
+      ++quotient;
+    }
+  }
+  static void divide_rounded(BigInteger& value, const BigInteger& divisor,
+                             RoundingMode mode) {
+    bool negative = value.is_negative() != divisor.is_negative();
+    BigInteger quotient;
+    BigInteger remainder;
+    divmod(value, divisor, quotient, remainder);
+    value = std::move(quotient);
+    BigInteger twice = remainder;
+    twice += remainder;
+    round_quotient(value, !remainder.is_zero(), twice.compare_abs(divisor),
+                   negative, mode);
+  }
+};
+
+BigDecimal operator+(const BigDecimal& first, const BigDecimal& second) {
+  BigDecimal tmp(first);
+  return tmp += second;
+}
+BigDecimal operator-(const BigDecimal& first, const BigDecimal& second) {
+  BigDecimal tmp(first);
+  return tmp -= second;
+}
+BigDecimal operator*(const BigDecimal& first, const BigDecimal& second) {
+  BigDecimal tmp(first);
+  return tmp *= second;
+}
+bool operator==(const BigDecimal& first, const BigDecimal& other) {
+  return first.compare(other) == 0;
+}
+bool operator!=(const BigDecimal& first, const BigDecimal& other) {
+  return first.compare(other) != 0;
+}
+bool operator<(const BigDecimal& first, const BigDecimal& other) {
+  return first.compare(other) < 0;
+}
+bool operator>(const BigDecimal& first, const BigDecimal& other) {
+  return first.compare(other) > 0;
+}
+bool operator<=(const BigDecimal& first, const BigDecimal& other) {
+  return first.compare(other) <= 0;
+}
+bool operator>=(const BigDecimal& first, const BigDecimal& other) {
+  return first.compare(other) >= 0;
+}
+std::ostream& operator<<(std::ostream& out, const BigDecimal& value) {
+  return out << value.toString();
+}
+
+// Montgomery arithmetic modulo an m coprime to 10, with R = base^n for the n
+// limbs of m. Residues are kept as n-limb spans in the form x * R mod m, so a
+// product needs one REDC pass instead of a division.
+class MontgomeryContext {
+ public:
+  explicit MontgomeryContext(const BigInteger& modulus)
+      : modulus_(modulus, true), size_(modulus.size()) {
+    if (!accepts(modulus_)) {
+      throw std::invalid_argument("Montgomery modulus must be coprime to 10");
+    }
+    uint64_t low = modulus_.blocks_[0];
+    int64_t old_r = BigInteger::base_;
+    int64_t r = low;
+    int64_t old_t = 0;
+    int64_t t = 1;
+    while (r != 0) {
+      int64_t quotient = old_r / r;
+      old_r -= quotient * r;
+      std::swap(old_r, r);
+      old_t -= quotient * t;
+      std::swap(old_t, t);
+    }
+    int64_t inverse = old_t < 0 ? old_t + BigInteger::base_ : old_t;
+    inverse_ = (BigInteger::base_ - inverse) % BigInteger::base_;
+    BigInteger one = BigInteger().power(size_);
+    one_ = limbs(one % modulus_);
+    r_squared_ = limbs(BigInteger().power(2 * size_) % modulus_);
+  }
+  static bool accepts(const BigInteger& modulus) {
+    uint64_t low = modulus.blocks_[0];
+    return low % 2 == 1 && low % 5 != 0 && !(BigInteger(modulus, true) == 1);
+  }
+  const BigInteger& modulus() const { return modulus_; }
+  BigInteger to_montgomery(const BigInteger& value) const {
+    LimbVector scratch(2 * size_ + 1, 0);
+    LimbVector result(size_, 0);
+    multiply(result.data(), limbs(reduce(value)).data(), r_squared_.data(),
+             scratch);
+    return from_limbs(result);
+  }
+  BigInteger from_montgomery(const BigInteger& value) const {
+    LimbVector scratch(2 * size_ + 1, 0);
+    LimbVector result(size_, 0);
+    LimbVector one(size_, 0);
+    one[0] = 1;
+    multiply(result.data(), limbs(value).data(), one.data(), scratch);
+    return from_limbs(result);
+  }
+  // Montgomery product REDC(first * second) of two values in Montgomery form.
+  BigInteger multiply(const BigInteger& first, const BigInteger& second) const {
+    LimbVector scratch(2 * size_ + 1, 0);
+    LimbVector result(size_, 0);
+    multiply(result.data(), limbs(first).data(), limbs(second).data(),
+             scratch);
+    return from_limbs(result);
+  }
+  BigInteger square(const BigInteger& value) const {
+    LimbVector scratch(2 * size_ + 1, 0);
+    LimbVector result(size_, 0);
+    square(result.data(), limbs(value).data(), scratch);
+    return from_limbs(result);
+  }
+  // base^exponent mod m for ordinary (not Montgomery form) values, using a
+  // left-to-right sliding window over the bits of the exponent.
+  BigInteger modpow(const BigInteger& base, const BigInteger& exponent) const {
+    if (exponent.is_negative()) {
+      throw std::invalid_argument("Negative exponent");
+    }
+    std::vector<uint32_t> bits = exponent.binary_words();
+    size_t bit_count = bits.size() * 32;
+    while (bit_count != 0 &&
+           ((bits[(bit_count - 1) / 32] >> ((bit_count - 1) % 32)) & 1) == 0) {
+      --bit_count;
+    }
+    auto bit = [&bits](size_t index) {
+      return (bits[index / 32] >> (index % 32)) & 1;
+    };
+    size_t window = bit_count > 671   ? 6
+                    : bit_count > 239 ? 5
+                    : bit_count > 79  ? 4
+                    : bit_count > 23  ? 3
+                                      : 1;
+    LimbVector scratch(2 * size_ + 1, 0);
+    // table[k] = base^(2k + 1) in Montgomery form.
+    std::vector<LimbVector> table(size_t(1) << (window - 1),
+                                  LimbVector(size_, 0));
+    LimbVector base_square(size_, 0);
+    multiply(table[0].data(), limbs(reduce(base)).data(), r_squared_.data(),
+             scratch);
+    square(base_square.data(), table[0].data(), scratch);
+    for (size_t k = 1; k < table.size(); ++k) {
+      multiply(table[k].data(), table[k - 1].data(), base_square.data(),
+               scratch);
+    }
+    LimbVector result = one_;
+    LimbVector tmp(size_, 0);
+    size_t position = bit_count;
+    while (position != 0) {
+      if (bit(position - 1) == 0) {
+        square(tmp.data(), result.data(), scratch);
+        std::swap(result, tmp);
+        --position;
+        continue;
+      }
+      size_t length = std::min(window, position);
+      while (bit(position - length) == 0) {
+        --length;
+      }
+      size_t value = 0;
+      for (size_t i = 0; i < length; ++i) {
+        value = 2 * value + bit(position - 1 - i);
+        square(tmp.data(), result.data(), scratch);
+        std::swap(result, tmp);
+      }
+      multiply(tmp.data(), result.data(), table[value / 2].data(), scratch);
+      std::swap(result, tmp);
+      position -= length;
+    }
+    LimbVector one(size_, 0);
+    one[0] = 1;
+    multiply(tmp.data(), result.data(), one.data(), scratch);
+    return from_limbs(tmp);
+  }
+
+ private:
+  BigInteger reduce(const BigInteger& value) const {
+    BigInteger result = value % modulus_;
+    if (result.is_negative()) {
+      result += modulus_;
+    }
+    return result;
+  }
+  // Copies a value below m into exactly size_ limbs.
+  LimbVector limbs(const BigInteger& value) const {
+    LimbVector result(size_, 0);
+    std::copy(value.blocks_.begin(), value.blocks_.end(), result.begin());
+    return result;
+  }
+  BigInteger from_limbs(const LimbVector& value) const {
+    BigInteger result;
+    result.blocks_ = value;
+    result.check_zeroes();
+    return result;
+  }
+  // result = REDC(scratch), where scratch holds a product below m * R.
+  void redc(uint64_t* result, LimbVector& scratch) const {
+    const uint64_t base = BigInteger::base_;
+    const uint64_t* modulus = modulus_.blocks_.data();
+    for (size_t i = 0; i < size_; ++i) {
+      uint64_t factor = scratch[i] * inverse_ % base;
+      uint64_t carry = 0;
+      for (size_t j = 0; j < size_; ++j) {
+        uint64_t cur = scratch[i + j] + factor * modulus[j] + carry;
+        scratch[i + j] = cur % base;
+        carry = cur / base;
+      }
+      for (size_t k = i + size_; carry != 0; ++k) {
+        uint64_t cur = scratch[k] + carry;
+        scratch[k] = cur % base;
+        carry = cur / base;
+      }
+    }
+    uint64_t* high = scratch.data() + size_;
+    if (high[size_] != 0 ||
+        BigInteger::compare_limbs(high, size_, modulus, size_) >= 0) {
+      BigInteger::sub_limbs(high, high, size_ + 1, modulus, size_);
+    }
+    std::copy(high, high + size_, result);
+  }
+  void multiply(uint64_t* result, const uint64_t* first,
+                const uint64_t* second, LimbVector& scratch) const {
+    std::fill(scratch.begin(), scratch.end(), 0);
+    BigInteger::multiply_limbs(scratch.data(), first, size_, second, size_);
+    redc(result, scratch);
+  }
+  void square(uint64_t* result, const uint64_t* value,
+              LimbVector& scratch) const {
+    std::fill(scratch.begin(), scratch.end(), 0);
+    BigInteger::multiply_limbs(scratch.data(), value, size_, value, size_);
+    redc(result, scratch);
+  }
+  BigInteger modulus_;
+  size_t size_;
+  uint64_t inverse_;  // -m^-1 mod base
+  LimbVector one_;    // R mod m
+  LimbVector r_squared_;
+};
+
+// base^exponent mod modulus; Montgomery multiplication when the modulus is
+// coprime to 10, plain square-and-multiply with divisions otherwise.
+BigInteger modpow(const BigInteger& base, const BigInteger& exponent,
+                  const BigInteger& modulus) {
+  if (exponent.is_negative()) {
+    throw std::invalid_argument("Negative exponent");
+  }
+  BigInteger abs_modulus(modulus, true);
+  if (abs_modulus == 1) {
+    return 0;
+  }
+  if (MontgomeryContext::accepts(abs_modulus)) {
+    return MontgomeryContext(abs_modulus).modpow(base, exponent);
+  }
+  BigInteger result = 1;
+  BigInteger power = base % abs_modulus;
+  if (power.is_negative()) {
+    power += abs_modulus;
+  }
+  BigInteger rest(exponent);
+  while (!rest.is_zero()) {
+    if (rest.is_odd()) {
+      result = result * power % abs_modulus;
+    }
+    power = power * power % abs_modulus;
+    rest /= 2;
+  }
+  return result;
+}
+
+// base^exponent by left-to-right binary exponentiation: every step squares
+// (through the squaring kernels of multiply_limbs) and then multiplies by
+// base itself, a short multiplication when base is a single limb. Trailing
+// decimal zeros of base are split off and restored by one decimal_shift, so
+// a power of ten costs no multiplication at all.
+BigInteger pow(const BigInteger& base, uint64_t exponent) {
+  if (exponent == 0) {
+    return 1;
+  }
+  if (base.is_zero()) {
+    return 0;
+  }
+  size_t zero_limbs = 0;
+  while (base.blocks_[zero_limbs] == 0) {
+    ++zero_limbs;
+  }
+  size_t zero_digits = BigInteger::base_power_ * zero_limbs;
+  int64_t divisor = 1;
+  for (uint64_t low = base.blocks_[zero_limbs]; low % 10 == 0; low /= 10) {
+    divisor *= 10;
+    ++zero_digits;
+  }
+  BigInteger factor = base.high_limbs(zero_limbs);
+  factor.sign_ = base.sign_;
+  if (divisor != 1) {
+    factor /= divisor;
+  }
+  BigInteger result = factor;
+  for (int bit = 62 - __builtin_clzll(exponent); bit >= 0; --bit) {
+    result *= result;
+    if ((exponent >> bit & 1) != 0) {
+      result *= factor;
+    }
+  }
+  result.decimal_shift(zero_digits * exponent);
+  return result;
+}
+
+// floor(|value|^(1 / degree)) for a non-negative value, or the negated root
+// of |value| for a negative value and odd degree. Roots of at most one limb
+// come from a double precision estimate corrected by exact powers. Larger
+// roots first take the root of value / base^(degree * m), which is exact in
+// more than half of the digits, and refine (r + 1) * base^m from above with
+// Newton steps x = ((degree - 1) * x + value / x^(degree - 1)) / degree, so
+// the work doubles the precision instead of running at full size. A single
+// step then usually lands on the root or one above it, which the exact
+// powers detect without a second division.
+BigInteger iroot(const BigInteger& value, uint64_t degree) {
+  if (degree == 0) {
+    throw std::invalid_argument("Zeroth root");
+  }
+  if (value.is_negative()) {
+    if (degree % 2 == 0) {
+      throw std::invalid_argument("Even root of a negative number");
+    }
+    return -iroot(-value, degree);
+  }
+  if (degree == 1 || (value.size() == 1 && value.blocks_[0] <= 1)) {
+    return value;
+  }
+  size_t root_size = (value.size() + degree - 1) / degree;
+  if (root_size <= 1) {
+    double estimate = std::exp(value.log_abs() / degree);
+    BigInteger root = static_cast<int64_t>(std::min(estimate, 1e9) + 0.5);
+    while (pow(root, degree) > value) {
+      --root;
+    }
+    while (pow(root + 1, degree) <= value) {
+      ++root;
+    }
+    return root;
+  }
+  size_t shift = std::max<size_t>((root_size - 1) / 2, 1);
+  BigInteger root = iroot(value.high_limbs(degree * shift), degree) + 1;
+  root.shift(shift);
+  while (true) {
+    BigInteger power = pow(root, degree - 1);
+    if (power * root <= value) {
+      return root;
+    }
+    BigInteger below = root - 1;
+    if (pow(below, degree) <= value) {
+      return below;
+    }
+    BigInteger next = value / power;
+    next += root * static_cast<int64_t>(degree - 1);
+    next /= static_cast<int64_t>(degree);
+    root = next < below ? std::move(next) : std::move(below);
+  }
+}
+
+BigInteger isqrt(const BigInteger& value) { return iroot(value, 2); }
+
+// Runs function(i) for every i in [0, count) on BigInteger::concurrency()
+// threads. If a call throws, the remaining indices are skipped and the
+// exception reaches the caller once every worker has stopped.
+template <typename Function>
+void parallel_for(size_t count, Function function) {
+  size_t threads_count = std::min(BigInteger::concurrency(), count);
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      try {
+        function(i);
+      } catch (...) {
+        next = count;
+        throw;
+      }
+    }
+  };
+  std::vector<std::future<void>> workers;
+  for (size_t i = 1; i < threads_count; ++i) {
+    workers.push_back(std::async(std::launch::async, worker));
+  }
+  worker();
+  for (auto& future : workers) {
+    future.get();
+  }
+}
+
+// Primes not exceeding limit, by the sieve of Eratosthenes.
+std::vector<uint32_t> primes_up_to(uint32_t limit) {
+  std::vector<bool> composite(static_cast<size_t>(limit) + 1, false);
+  std::vector<uint32_t> result;
+  for (uint64_t i = 2; i <= limit; ++i) {
+    if (!composite[i]) {
+      result.push_back(static_cast<uint32_t>(i));
+      for (uint64_t j = i * i; j <= limit; j += i) {
+        composite[j] = true;
+      }
+    }
+  }
+  return result;
+}
+
+const std::vector<uint32_t>& small_primes() {
+  static const std::vector<uint32_t> primes = primes_up_to(1000);
+  return primes;
+}
+
+// Jacobi symbol (value / modulus) for odd modulus.
+int jacobi(uint64_t value, uint64_t modulus) {
+  int result = 1;
+  value %= modulus;
+  while (value != 0) {
+    while (value % 2 == 0) {
+      value /= 2;
+      if (modulus % 8 == 3 || modulus % 8 == 5) {
+        result = -result;
+      }
+    }
+    std::swap(value, modulus);
+    if (value % 4 == 3 && modulus % 4 == 3) {
+      result = -result;
+    }
+    value %= modulus;
+  }
+  return modulus == 1 ? result : 0;
+}
+
+// Jacobi symbol (value / n) for a small value and a large odd n.
+int jacobi(int64_t value, const BigInteger& n) {
+  int result = 1;
+  if (value < 0) {
+    value = -value;
+    if (n.abs_mod(4) == 3) {
+      result = -result;
+    }
+  }
+  while (value % 2 == 0) {
+    value /= 2;
+    uint64_t rest = n.abs_mod(8);
+    if (rest == 3 || rest == 5) {
+      result = -result;
+    }
+  }
+  if (value % 4 == 3 && n.abs_mod(4) == 3) {
+    result = -result;
+  }
+  return result * jacobi(n.abs_mod(value), static_cast<uint64_t>(value));
+}
+
+BigInteger add_mod(const BigInteger& first, const BigInteger& second,
+                   const BigInteger& modulus) {
+  BigInteger result = first + second;
+  if (result >= modulus) {
+    result -= modulus;
+  }
+  return result;
+}
+
+BigInteger sub_mod(const BigInteger& first, const BigInteger& second,
+                   const BigInteger& modulus) {
+  BigInteger result = first - second;
+  if (result.is_negative()) {
+    result += modulus;
+  }
+  return result;
+}
+
+BigInteger half_mod(const BigInteger& value, const BigInteger& modulus) {
+  return (value.is_odd() ? value + modulus : value) / 2;
+}
+
+// Strong base-2 Miller-Rabin test of an odd n > 2 coprime to 10.
+bool strong_fermat_base_two(const BigInteger& n,
+                            const MontgomeryContext& context) {
+  BigInteger odd_part = n - 1;
+  size_t twos = 0;
+  while (!odd_part.is_odd()) {
+    odd_part /= 2;
+    ++twos;
+  }
+  BigInteger minus_one = context.to_montgomery(n - 1);
+  BigInteger one = context.to_montgomery(1);
+  BigInteger power = context.to_montgomery(context.modpow(2, odd_part));
+  if (power == one || power == minus_one) {
+    return true;
+  }
+  for (size_t i = 1; i < twos; ++i) {
+    power = context.square(power);
+    if (power == minus_one) {
+      return true;
+    }
+    if (power == one) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// Strong Lucas test with Selfridge's parameters: D is the first of
+// 5, -7, 9, -11, ... with (D / n) = -1, P = 1 and Q = (1 - D) / 4.
+bool strong_lucas(const BigInteger& n, const MontgomeryContext& context) {
+  int64_t d = 5;
+  while (true) {
+    int symbol = jacobi(d, n);
+    if (symbol == -1) {
+      break;
+    }
+    if (symbol == 0 && !(BigInteger(d < 0 ? -d : d) == n)) {
+      return false;
+    }
+    d = d > 0 ? -(d + 2) : -d + 2;
+    if (d == 21) {
+      BigInteger root = isqrt(n);
+      if (root * root == n) {
+        return false;
+      }
+    }
+  }
+  auto montgomery = [&](int64_t value) {
+    BigInteger result = BigInteger(value) % n;
+    if (result.is_negative()) {
+      result += n;
+    }
+    return context.to_montgomery(result);
+  };
+  BigInteger big_d = montgomery(d);
+  BigInteger q = montgomery((1 - d) / 4);
+  BigInteger odd_part = n + 1;
+  size_t twos = 0;
+  while (!odd_part.is_odd()) {
+    odd_part /= 2;
+    ++twos;
+  }
+  std::vector<uint32_t> words = odd_part.binary_words();
+  size_t bits = words.size() * 32;
+  while (((words[(bits - 1) / 32] >> ((bits - 1) % 32)) & 1) == 0) {
+    --bits;
+  }
+  BigInteger u = montgomery(1);
+  BigInteger v = u;
+  BigInteger q_power = q;
+  for (size_t i = bits - 1; i != 0; --i) {
+    u = context.multiply(u, v);
+    v = sub_mod(context.square(v), add_mod(q_power, q_power, n), n);
+    q_power = context.square(q_power);
+    if (((words[(i - 1) / 32] >> ((i - 1) % 32)) & 1) != 0) {
+      BigInteger next_u = half_mod(add_mod(u, v, n), n);
+      v = half_mod(add_mod(context.multiply(big_d, u), v, n), n);
+      u = std::move(next_u);
+      q_power = context.multiply(q_power, q);
+    }
+  }
+  if (u.is_zero() || v.is_zero()) {
+    return true;
+  }
+  for (size_t r = 1; r < twos; ++r) {
+    v = sub_mod(context.square(v), add_mod(q_power, q_power, n), n);
+    if (v.is_zero()) {
+      return true;
+    }
+    q_power = context.square(q_power);
+  }
+  return false;
+}
+
+// Baillie-PSW probable-prime test: trial division by the primes below 1000,
+// then a strong base-2 Miller-Rabin test and a strong Lucas test.
+bool is_probable_prime(const BigInteger& n) {
+  if (n.is_negative() || n < 2) {
+    return false;
+  }
+  for (uint32_t prime : small_primes()) {
+    if (n.abs_mod(prime) == 0) {
+      return n == BigInteger(prime);
+    }
+  }
+  if (n < 1000 * 1000) {
+    return true;
+  }
+  MontgomeryContext context(n);
+  return strong_fermat_base_two(n, context) && strong_lucas(n, context);
+}
+
+// All probable primes in [from, to]: the range is sieved by the small primes
+// and the survivors are tested in parallel.
+std::vector<BigInteger> primes_in_range(const BigInteger& from,
+                                        const BigInteger& to) {
+  if (to < from) {
+    return {};
+  }
+  size_t count = static_cast<size_t>(static_cast<double>(to - from)) + 1;
+  std::vector<char> composite(count, 0);
+  for (uint32_t prime : small_primes()) {
+    size_t offset = (prime - from.abs_mod(prime)) % prime;
+    if (from.is_negative()) {
+      offset = from.abs_mod(prime);
+    }
+    for (size_t i = offset; i < count; i += prime) {
+      composite[i] = from + static_cast<int64_t>(i) != BigInteger(prime);
+    }
+  }
+  std::vector<size_t> candidates;
+  for (size_t i = 0; i < count; ++i) {
+    if (composite[i] == 0) {
+      candidates.push_back(i);
+    }
+  }
+  std::vector<char> prime(candidates.size(), 0);
+  parallel_for(candidates.size(), [&](size_t index) {
+    prime[index] =
+        is_probable_prime(from + static_cast<int64_t>(candidates[index]));
+  });
+  std::vector<BigInteger> result;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (prime[i] != 0) {
+      result.push_back(from + static_cast<int64_t>(candidates[i]));
+    }
+  }
+  return result;
+}
+
+// Whether value can be a prime-th power: for primes q = 1 (mod prime), a
+// power is a prime-th power residue mod q, which holds for a random value
+// with probability 1 / prime per q.
+bool is_power_residue(const BigInteger& value, uint32_t prime) {
+  size_t checked = 0;
+  for (uint64_t modulus = 2 * prime + 1; checked < 4; modulus += 2 * prime) {
+    bool modulus_prime = true;
+    for (uint64_t divisor = 3; divisor * divisor <= modulus; divisor += 2) {
+      if (modulus % divisor == 0) {
+        modulus_prime = false;
+        break;
+      }
+    }
+    if (!modulus_prime) {
+      continue;
+    }
+    ++checked;
+    uint64_t residue = value.abs_mod(modulus);
+    if (residue == 0) {
+      continue;
+    }
+    uint64_t power = 1;
+    for (uint64_t exponent = (modulus - 1) / prime; exponent != 0;
+         exponent /= 2) {
+      if (exponent % 2 == 1) {
+        power = power * residue % modulus;
+      }
+      residue = residue * residue % modulus;
+    }
+    if (power != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether |value| = r^e with e >= 2 (odd e for a negative value); reports
+// the root and the largest such exponent. Prime exponents up to log2 are
+// tried; power residues and, for roots below 10^8, the double estimate of
+// the root rule out almost all of them without big arithmetic.
+bool is_perfect_power(const BigInteger& value, BigInteger* root = nullptr,
+                      uint64_t* exponent = nullptr) {
+  BigInteger base = value;
+  uint64_t total = 1;
+  if (base == 0 || base == 1 || base == -1) {
+    total = base == -1 ? 3 : 2;
+  }
+  bool found = total == 1;
+  while (found) {
+    found = false;
+    auto limit = static_cast<uint32_t>(base.log_abs() / std::log(2.0)) + 1;
+    for (uint32_t prime : primes_up_to(limit)) {
+      if (prime == 2 && base.is_negative()) {
+        continue;
+      }
+      // log_abs reads two limbs, so the estimate is only good to about
+      // 1e-9 of the root when the leading limb is small.
+      double estimate = std::exp(base.log_abs() / prime);
+      if ((estimate < 1e8 && std::abs(estimate - std::round(estimate)) >
+                                 estimate * 1e-8 + 1e-6) ||
+          !is_power_residue(base, prime)) {
+        continue;
+      }
+      BigInteger candidate = iroot(base, prime);
+      if (pow(candidate, prime) == base) {
+        base = std::move(candidate);
+        total *= prime;
+        found = true;
+        break;
+      }
+    }
+  }
+  if (total == 1) {
+    return false;
+  }
+  if (root != nullptr) {
+    *root = base;
+  }
+  if (exponent != nullptr) {
+    *exponent = total;
+  }
+  return true;
+}
+
+inline BigInteger product_leaf(uint64_t value) {
+  return BigInteger::from_unsigned(value);
+}
+
+template <typename Value>
+BigInteger product_leaf(const Value& value) {
+  return BigInteger(value);
+}
+
+// Product of [begin, end) by a balanced product tree, so that the operands
+// of every multiplication have similar sizes. At most threads threads (and
+// at most BigInteger::concurrency()) run at once: the halves split the
+// budget, and the multiplication joining them uses all of it.
+template <typename Iterator>
+BigInteger product(Iterator begin, Iterator end, size_t threads = 1) {
+  threads = std::max<size_t>(std::min(threads, BigInteger::concurrency()), 1);
+  size_t count = std::distance(begin, end);
+  if (count == 0) {
+    return 1;
+  }
+  if (count == 1) {
+    return product_leaf(*begin);
+  }
+  Iterator middle = std::next(begin, count / 2);
+  if (threads > 1) {
+    auto left = std::async(std::launch::async, [=]() {
+      return product(begin, middle, threads / 2);
+    });
+    BigInteger right = product(middle, end, threads - threads / 2);
+    return multiply(left.get(), right, threads);
+  }
+  return multiply(product(begin, middle), product(middle, end), 1);
+}
+
+template <typename Range>
+BigInteger product(const Range& range, size_t threads = 1) {
+  return product(std::begin(range), std::end(range), threads);
+}
+
+// Multiplies factor into the last packed factor while the result stays
+// within 10^18, so the tree leaves are not single words. Larger factors are
+// kept as they are.
+void push_factor(std::vector<uint64_t>& packed, uint64_t factor) {
+  const uint64_t limit = 1000000000000000000;
+  if (!packed.empty() && packed.back() <= limit / factor) {
+    packed.back() *= factor;
+  } else {
+    packed.push_back(factor);
+  }
+}
+
+BigInteger factorial(uint64_t n, size_t threads = 1) {
+  std::vector<uint64_t> packed;
+  for (uint64_t i = 2; i <= n; ++i) {
+    push_factor(packed, i);
+  }
+  return product(packed, threads);
+}
+
+// Product of the primes not exceeding n.
+BigInteger primorial(uint32_t n, size_t threads = 1) {
+  std::vector<uint64_t> packed;
+  for (uint32_t prime : primes_up_to(n)) {
+    push_factor(packed, prime);
+  }
+  return product(packed, threads);
+}
+
+// C(n, k) from its prime factorization: the exponent of p is the number of
+// carries when adding k and n - k in base p (Kummer's theorem). The sieve
+// costs O(n), so huge n and k below sqrt(n) instead divide the falling
+// factorial by k!.
+BigInteger binomial(uint64_t n, uint64_t k, size_t threads = 1) {
+  if (k > n) {
+    return 0;
+  }
+  k = std::min(k, n - k);
+  if (k == 0) {
+    return 1;
+  }
+  std::vector<uint64_t> packed;
+  if (n >= (1ull << 28) || k < n / k) {
+    for (uint64_t i = 0; i < k; ++i) {
+      push_factor(packed, n - i);
+    }
+    return product(packed, threads) / factorial(k, threads);
+  }
+  for (uint32_t prime : primes_up_to(static_cast<uint32_t>(n))) {
+    uint64_t first = k;
+    uint64_t second = n - k;
+    uint64_t carry = 0;
+    while (first != 0 || second != 0 || carry != 0) {
+      carry = (first % prime + second % prime + carry) >= prime;
+      if (carry != 0) {
+        push_factor(packed, prime);
+      }
+      first /= prime;
+      second /= prime;
+    }
+  }
+  return product(packed, threads);
+}
+
+// Signed integer of exactly Bits bits (a multiple of 64) in two's complement
+// with std::array limbs in base 2^64, usable in constant expressions.
+// Arithmetic wraps modulo 2^Bits; division truncates like BigInteger.
+template <size_t Bits>
+class FixedBigInt {
+  static_assert(Bits != 0 && Bits % 64 == 0, "Bits must be a multiple of 64");
+
+ public:
+  static constexpr size_t kLimbs = Bits / 64;
+  constexpr FixedBigInt() : limbs_() {}
+  constexpr FixedBigInt(int64_t value) : limbs_() {
+    limbs_[0] = static_cast<uint64_t>(value);
+    for (size_t i = 1; i < kLimbs; ++i) {
+      limbs_[i] = value < 0 ? ~0ull : 0;
+    }
+  }
+  explicit FixedBigInt(const std::string& str) : limbs_() {
+    size_t begin = (!str.empty() && (str[0] == '-' || str[0] == '+')) ? 1 : 0;
+    for (size_t i = begin; i < str.size(); ++i) {
+      *this *= 10;
+      *this += str[i] - '0';
+    }
+    if (begin == 1 && str[0] == '-') {
+      negate();
+    }
+  }
+  // Keeps the low Bits bits of value.
+  explicit FixedBigInt(const BigInteger& value) : limbs_() {
+    std::vector<uint32_t> words = value.binary_words();
+    for (size_t i = 0; i < words.size() && i < 2 * kLimbs; ++i) {
+      limbs_[i / 2] |= static_cast<uint64_t>(words[i]) << (i % 2 * 32);
+    }
+    if (value.is_negative()) {
+      negate();
+    }
+  }
+  explicit operator BigInteger() const {
+    FixedBigInt magnitude = is_negative() ? -*this : *this;
+    BigInteger result;
+    for (size_t i = kLimbs; i != 0; --i) {
+      result *= BigInteger(1ll << 32);
+      result += static_cast<int64_t>(magnitude.limbs_[i - 1] >> 32);
+      result *= BigInteger(1ll << 32);
+      result += static_cast<int64_t>(magnitude.limbs_[i - 1] & 0xffffffff);
+    }
+    return is_negative() ? -result : result;
+  }
+  constexpr FixedBigInt& operator+=(const FixedBigInt& other) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < kLimbs; ++i) {
+      uint64_t sum = limbs_[i] + carry;
+      carry = sum < carry ? 1 : 0;
+      limbs_[i] = sum + other.limbs_[i];
+      carry += limbs_[i] < sum ? 1 : 0;
+    }
+    return *this;
+  }
+  constexpr FixedBigInt& operator-=(const FixedBigInt& other) {
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < kLimbs; ++i) {
+      uint64_t difference = limbs_[i] - borrow;
+      borrow = limbs_[i] < borrow ? 1 : 0;
+      borrow += difference < other.limbs_[i] ? 1 : 0;
+      limbs_[i] = difference - other.limbs_[i];
+    }
+    return *this;
+  }
+  constexpr FixedBigInt& operator*=(const FixedBigInt& other) {
+    std::array<uint64_t, kLimbs> product{};
+    for (size_t i = 0; i < kLimbs; ++i) {
+      uint64_t carry = 0;
+      for (size_t j = 0; i + j < kLimbs; ++j) {
+        uint64_t low = 0;
+        uint64_t high = mul_wide(limbs_[i], other.limbs_[j], low);
+        low += carry;
+        high += low < carry ? 1 : 0;
+        product[i + j] += low;
+        high += product[i + j] < low ? 1 : 0;
+        carry = high;
+      }
+    }
+    limbs_ = product;
+    return *this;
+  }
+  constexpr FixedBigInt& operator/=(const FixedBigInt& other) {
+    FixedBigInt remainder;
+    divmod(*this, other, *this, remainder);
+    return *this;
+  }
+  constexpr FixedBigInt& operator%=(const FixedBigInt& other) {
+    FixedBigInt quotient;
+    divmod(*this, other, quotient, *this);
+    return *this;
+  }
+  constexpr FixedBigInt& operator++() { return *this += 1; }
+  constexpr FixedBigInt operator++(int) {
+    FixedBigInt old(*this);
+    *this += 1;
+    return old;
+  }
+  constexpr FixedBigInt& operator--() { return *this -= 1; }
+  constexpr FixedBigInt operator--(int) {
+    FixedBigInt old(*this);
+    *this -= 1;
+    return old;
+  }
+  constexpr FixedBigInt operator-() const {
+    FixedBigInt result(*this);
+    result.negate();
+    return result;
+  }
+  constexpr FixedBigInt operator+() const { return *this; }
+  constexpr explicit operator bool() const { return !is_zero(); }
+  constexpr bool is_zero() const {
+    for (size_t i = 0; i < kLimbs; ++i) {
+      if (limbs_[i] != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+  constexpr bool is_negative() const { return limbs_[kLimbs - 1] >> 63 != 0; }
+  constexpr const std::array<uint64_t, kLimbs>& limbs() const {
+    return limbs_;
+  }
+  std::string toString() const {
+    FixedBigInt magnitude = is_negative() ? -*this : *this;
+    std::string digits;
+    do {
+      uint64_t chunk = magnitude.short_div(1000000000);
+      for (size_t i = 0; i < 9; ++i) {
+        digits.push_back(static_cast<char>('0' + chunk % 10));
+        chunk /= 10;
+      }
+    } while (!magnitude.is_zero());
+    while (digits.size() > 1 && digits.back() == '0') {
+      digits.pop_back();
+    }
+    if (is_negative()) {
+      digits.push_back('-');
+    }
+    return std::string(digits.rbegin(), digits.rend());
+  }
+
+  friend constexpr FixedBigInt operator+(FixedBigInt first,
+                                         const FixedBigInt& second) {
+    return first += second;
+  }
+  friend constexpr FixedBigInt operator-(FixedBigInt first,
+                                         const FixedBigInt& second) {
+    return first -= second;
+  }
+  friend constexpr FixedBigInt operator*(FixedBigInt first,
+                                         const FixedBigInt& second) {
+    return first *= second;
+  }
+  friend constexpr FixedBigInt operator/(FixedBigInt first,
+                                         const FixedBigInt& second) {
+    return first /= second;
+  }
+  friend constexpr FixedBigInt operator%(FixedBigInt first,
+                                         const FixedBigInt& second) {
+    return first %= second;
+  }
+  friend constexpr bool operator==(const FixedBigInt& first,
+                                   const FixedBigInt& second) {
+    for (size_t i = 0; i < kLimbs; ++i) {
+      if (first.limbs_[i] != second.limbs_[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+  friend constexpr bool operator!=(const FixedBigInt& first,
+                                   const FixedBigInt& second) {
+    return !(first == second);
+  }
+  friend constexpr bool operator<(const FixedBigInt& first,
+                                  const FixedBigInt& second) {
+    if (first.is_negative() != second.is_negative()) {
+      return first.is_negative();
+    }
+    return compare_unsigned(first, second) < 0;
+  }
+  friend constexpr bool operator>(const FixedBigInt& first,
+                                  const FixedBigInt& second) {
+    return second < first;
+  }
+  friend constexpr bool operator<=(const FixedBigInt& first,
+                                   const FixedBigInt& second) {
+    return !(second < first);
+  }
+  friend constexpr bool operator>=(const FixedBigInt& first,
+                                   const FixedBigInt& second) {
+    return !(first < second);
+  }
+  friend std::ostream& operator<<(std::ostream& out,
+                                  const FixedBigInt& value) {
+    out << value.toString();
+    return out;
+  }
+  friend std::istream& operator>>(std::istream& in, FixedBigInt& value) {
+    std::string str;
+    in >> str;
+    value = FixedBigInt(str);
+    return in;
+  }
+
+ private:
+  // Returns the high word of first * second and stores the low one.
+  static constexpr uint64_t mul_wide(uint64_t first, uint64_t second,
+                                     uint64_t& low) {
+    uint64_t first_low = first & 0xffffffff;
+    uint64_t first_high = first >> 32;
+    uint64_t second_low = second & 0xffffffff;
+    uint64_t second_high = second >> 32;
+    uint64_t low_low = first_low * second_low;
+    uint64_t high_low = first_high * second_low;
+    uint64_t low_high = first_low * second_high;
+    uint64_t middle =
+        (low_low >> 32) + (high_low & 0xffffffff) + (low_high & 0xffffffff);
+    low = (middle << 32) | (low_low & 0xffffffff);
+    return first_high * second_high + (high_low >> 32) + (low_high >> 32) +
+           (middle >> 32);
+  }
+  static constexpr int compare_unsigned(const FixedBigInt& first,
+                                        const FixedBigInt& second) {
+    for (size_t i = kLimbs; i != 0; --i) {
+      if (first.limbs_[i - 1] != second.limbs_[i - 1]) {
+        return first.limbs_[i - 1] < second.limbs_[i - 1] ? -1 : 1;
+      }
+    }
+    return 0;
+  }
+  constexpr void negate() {
+    for (size_t i = 0; i < kLimbs; ++i) {
+      limbs_[i] = ~limbs_[i];
+    }
+    *this += 1;
+  }
+  // Divides the value, read as unsigned, by 0 < value < 2^32 in place and
+  // returns the remainder.
+  constexpr uint64_t short_div(uint64_t value) {
+    uint64_t remainder = 0;
+    for (size_t i = kLimbs; i != 0; --i) {
+      uint64_t high = (remainder << 32) | (limbs_[i - 1] >> 32);
+      remainder = high % value;
+      uint64_t low = (remainder << 32) | (limbs_[i - 1] & 0xffffffff);
+      remainder = low % value;
+      limbs_[i - 1] = (high / value) << 32 | low / value;
+    }
+    return remainder;
+  }
+  // Truncating division of the magnitudes, read as unsigned, bit by bit
+  // (or by short_div for one-word divisors), with the signs fixed after.
+  static constexpr void divmod(const FixedBigInt& first,
+                               const FixedBigInt& second,
+                               FixedBigInt& quotient, FixedBigInt& remainder) {
+    if (second.is_zero()) {
+      throw std::overflow_error("Divide by zero exception");
+    }
+    bool negative_quotient = first.is_negative() != second.is_negative();
+    bool negative_remainder = first.is_negative();
+    FixedBigInt dividend = first.is_negative() ? -first : first;
+    FixedBigInt divisor = second.is_negative() ? -second : second;
+    if (compare_unsigned(divisor, FixedBigInt(1ll << 32)) < 0) {
+      remainder = FixedBigInt(
+          static_cast<int64_t>(dividend.short_div(divisor.limbs_[0])));
+      quotient = dividend;
+    } else {
+      FixedBigInt result;
+      FixedBigInt rest;
+      for (size_t bit = Bits; bit != 0; --bit) {
+        for (size_t i = kLimbs - 1; i != 0; --i) {
+          rest.limbs_[i] = rest.limbs_[i] << 1 | rest.limbs_[i - 1] >> 63;
+        }
+        rest.limbs_[0] = rest.limbs_[0] << 1 |
+                         (dividend.limbs_[(bit - 1) / 64] >> ((bit - 1) % 64) &
+                          1);
+        if (compare_unsigned(rest, divisor) >= 0) {
+          rest -= divisor;
+          result.limbs_[(bit - 1) / 64] |= 1ull << ((bit - 1) % 64);
+        }
+      }
+      quotient = result;
+      remainder = rest;
+    }
+    if (negative_quotient) {
+      quotient.negate();
+    }
+    if (negative_remainder) {
+      remainder.negate();
+    }
+  }
+  std::array<uint64_t, kLimbs> limbs_;
+};
+
+using Int256 = FixedBigInt<256>;
+using Int512 = FixedBigInt<512>;
+
+// Binary encoding. A value starts with an LEB128 varint header h. If h is
+// even, the value is the zigzag-decoded h / 2 (values of at most two limbs,
+// so below 10^18). Otherwise bit 1 of h is the sign (set for negative) and
+// h / 4 base 10^9 limbs follow as little-endian uint32, least significant
+// first, with a non-zero top limb. A Rational is its numerator followed by
+// its positive denominator; a bulk array is a varint count and the values.
+
+void write_varint(uint64_t value, std::vector<uint8_t>& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t read_varint(const uint8_t* data, size_t size, size_t& offset) {
+  uint64_t value = 0;
+  for (size_t shift = 0; shift < 64; shift += 7) {
+    if (offset >= size) {
+      break;
+    }
+    uint8_t byte = data[offset++];
+    // Only the lowest bit of a tenth byte fits; more is an overlong value.
+    if (shift == 63 && byte > 1) {
+      break;
+    }
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::invalid_argument("Malformed BigInteger encoding");
+}
+
+void serialize(const BigInteger& value, std::vector<uint8_t>& out) {
+  if (value.size() <= 2) {
+    int64_t small = static_cast<int64_t>(value.leading_limbs(2));
+    uint64_t zigzag = value.is_negative() ? 2 * static_cast<uint64_t>(small) - 1
+                                          : 2 * static_cast<uint64_t>(small);
+    write_varint(zigzag << 1, out);
+    return;
+  }
+  write_varint(value.size() << 2 | (value.is_negative() ? 3 : 1), out);
+  size_t offset = out.size();
+  out.resize(offset + 4 * value.size());
+  BigInteger::store_limbs(out.data() + offset, value.blocks_.data(),
+                          value.size());
+}
+
+// A serialized BigInteger read in place, e.g. from a memory-mapped file:
+// the limbs are only copied out by value().
+class BigIntegerView {
+ public:
+  BigIntegerView(const uint8_t* data, size_t size) {
+    size_t offset = 0;
+    uint64_t header = read_varint(data, size, offset);
+    if ((header & 1) == 0) {
+      uint64_t zigzag = header >> 1;
+      small_ = (zigzag & 1) != 0 ? -static_cast<int64_t>((zigzag + 1) / 2)
+                                 : static_cast<int64_t>(zigzag / 2);
+      negative_ = small_ < 0;
+      encoded_size_ = offset;
+      return;
+    }
+    negative_ = (header & 2) != 0;
+    size_ = header >> 2;
+    limbs_ = data + offset;
+    if (size_ == 0 || size_ > (size - offset) / 4 || limb(size_ - 1) == 0) {
+      throw std::invalid_argument("Malformed BigInteger encoding");
+    }
+    encoded_size_ = offset + 4 * size_;
+  }
+  size_t encoded_size() const { return encoded_size_; }
+  bool is_negative() const { return negative_; }
+  // Number of base 10^9 limbs; 0 for the varint form.
+  size_t size() const { return size_; }
+  uint32_t limb(size_t index) const {
+    uint32_t result;
+    std::memcpy(&result, limbs_ + 4 * index, 4);
+    return result;
+  }
+  BigInteger value() const {
+    if (size_ == 0) {
+      return small_;
+    }
+    BigInteger result;
+    result.blocks_.resize(size_);
+    BigInteger::load_limbs(result.blocks_.data(), limbs_, size_);
+    for (size_t i = 0; i < size_; ++i) {
+      if (result.blocks_[i] >= static_cast<uint64_t>(BigInteger::base_)) {
+        throw std::invalid_argument("Malformed BigInteger encoding");
+      }
+    }
+    result.sign_ = !negative_;
+    return result;
+  }
+
+ private:
+  const uint8_t* limbs_ = nullptr;
+  size_t size_ = 0;
+  size_t encoded_size_ = 0;
+  int64_t small_ = 0;
+  bool negative_ = false;
+};
+
+void serialize(const Rational& value, std::vector<uint8_t>& out) {
+  serialize(value.numerator_, out);
+  serialize(value.denominator_, out);
+}
+
+class RationalView {
+ public:
+  RationalView(const uint8_t* data, size_t size)
+      : numerator_(data, size),
+        denominator_(data + numerator_.encoded_size(),
+                     size - numerator_.encoded_size()) {
+    if (denominator_.is_negative() ||
+        (denominator_.size() == 0 && denominator_.value() == 0)) {
+      throw std::invalid_argument("Malformed Rational encoding");
+    }
+  }
+  size_t encoded_size() const {
+    return numerator_.encoded_size() + denominator_.encoded_size();
+  }
+  const BigIntegerView& numerator() const { return numerator_; }
+  const BigIntegerView& denominator() const { return denominator_; }
+  Rational value() const {
+    Rational result;
+    result.numerator_ = numerator_.value();
+    result.denominator_ = denominator_.value();
+    result.reduced_ = result.denominator_ == 1;
+    return result;
+  }
+
+ private:
+  BigIntegerView numerator_;
+  BigIntegerView denominator_;
+};
+
+template <typename Value>
+std::vector<uint8_t> serialize_all(const std::vector<Value>& values) {
+  std::vector<uint8_t> out;
+  write_varint(values.size(), out);
+  for (const Value& value : values) {
+    serialize(value, out);
+  }
+  return out;
+}
+
+// deserialize_all<BigIntegerView> or deserialize_all<RationalView>.
+template <typename View,
+          typename Value = decltype(std::declval<View>().value())>
+std::vector<Value> deserialize_all(const uint8_t* data, size_t size) {
+  size_t offset = 0;
+  uint64_t count = read_varint(data, size, offset);
+  std::vector<Value> values;
+  values.reserve(std::min<uint64_t>(count, size));
+  for (uint64_t i = 0; i < count; ++i) {
+    View view(data + offset, size - offset);
+    values.push_back(view.value());
+    offset += view.encoded_size();
+  }
+  return values;
+}
@@ -0,0 +1,564 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "BigInteger.cpp"
+
+std::mt19937_64 generator(2024);
+
+BigInteger random_number(size_t digits) {
+  std::string str(1, static_cast<char>('1' + generator() % 9));
+  while (str.size() < digits) {
+    str.push_back(static_cast<char>('0' + generator() % 10));
+  }
+  return BigInteger(str);
+}
+
+template <typename Function>
+double seconds_per_call(Function function, size_t repeats) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < repeats; ++i) {
+    function();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / repeats;
+}
+
+// Square-and-multiply over the decimal digits of the exponent, reducing
+// every product with a full division.
+BigInteger naive_modpow(const BigInteger& base, const BigInteger& exponent,
+                        const BigInteger& modulus) {
+  BigInteger powers[10] = {1};
+  for (size_t i = 1; i < 10; ++i) {
+    powers[i] = powers[i - 1] * base % modulus;
+  }
+  BigInteger result = 1;
+  for (char digit : exponent.toString()) {
+    BigInteger square = result * result % modulus;
+    BigInteger fourth = square * square % modulus;
+    BigInteger fifth = fourth * result % modulus;
+    result = fifth * fifth % modulus * powers[digit - '0'] % modulus;
+  }
+  return result;
+}
+
+void benchmark_modpow(size_t bits) {
+  size_t digits = bits * 30103 / 100000;
+  BigInteger modulus = random_number(digits) * 10 + 7;
+  BigInteger base = random_number(digits);
+  BigInteger exponent = random_number(digits);
+  MontgomeryContext context(modulus);
+  BigInteger first = context.to_montgomery(base);
+  BigInteger second = context.to_montgomery(exponent);
+  size_t repeats = 40000000 / (digits * digits) + 1;
+  double naive_mulmod =
+      seconds_per_call([&] { return base * exponent % modulus; }, repeats);
+  double montgomery_mulmod = seconds_per_call(
+      [&] { return context.multiply(first, second); }, repeats);
+  BigInteger expected;
+  double naive = seconds_per_call(
+      [&] { expected = naive_modpow(base, exponent, modulus); }, 1);
+  BigInteger result;
+  double montgomery = seconds_per_call(
+      [&] { result = context.modpow(base, exponent); }, 1);
+  std::cout << bits << "-bit modulus: mulmod " << naive_mulmod * 1e6
+            << " us naive, " << montgomery_mulmod * 1e6
+            << " us Montgomery; modpow " << naive * 1e3 << " ms naive, "
+            << montgomery * 1e3 << " ms Montgomery"
+            << (result == expected ? "" : " (MISMATCH)") << std::endl;
+}
+
+// Nanoseconds per limb of in-place add, subtract and short multiply (the
+// latter timed with a copy of the operand) at every supported SIMD level.
+void benchmark_limb_kernels(size_t limbs) {
+  BigInteger first = random_number(limbs * 9);
+  BigInteger second = random_number(limbs * 9);
+  size_t repeats = 20000000 / limbs + 1;
+  std::cout << limbs << " limbs:";
+  const char* names[] = {"scalar", "avx2", "avx512"};
+  for (SimdLevel level :
+       {SimdLevel::kScalar, SimdLevel::kAvx2, SimdLevel::kAvx512}) {
+    BigInteger::set_simd_level(level);
+    if (BigInteger::simd_level() != level) {
+      continue;
+    }
+    BigInteger sum = first;
+    double add = seconds_per_call([&] { sum += second; }, repeats);
+    double sub = seconds_per_call([&] { sum -= second; }, repeats);
+    BigInteger product;
+    double mult = seconds_per_call(
+        [&] {
+          product = first;
+          product *= 999999937;
+        },
+        repeats);
+    double scale = 1e9 / limbs;
+    std::cout << " " << names[static_cast<int>(level)] << " add "
+              << add * scale << " sub " << sub * scale << " mult "
+              << mult * scale << ";";
+  }
+  std::cout << " ns/limb" << std::endl;
+  BigInteger::set_simd_level(SimdLevel::kAvx512);
+}
+
+// Mixed-sign values of 1 to 40 digits, so that most comparisons are decided
+// by sign or size and the rest by a few top limbs.
+void benchmark_sort(size_t count) {
+  std::vector<BigInteger> values;
+  values.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    values.push_back(random_number(1 + generator() % 40));
+    if (generator() % 2 == 0) {
+      values.back() = -values.back();
+    }
+  }
+  double seconds = seconds_per_call(
+      [&values] { std::sort(values.begin(), values.end()); }, 1);
+  std::cout << "sort " << count << " values: " << seconds << " s"
+            << std::endl;
+}
+
+// Sums count terms of the given length, cycling through a pool of random
+// mixed-sign values, with += and with BigIntegerAccumulator.
+void benchmark_sum(size_t count, size_t digits) {
+  std::vector<BigInteger> pool;
+  for (size_t i = 0; i < 1024; ++i) {
+    pool.push_back(random_number(digits));
+    if (generator() % 2 == 0) {
+      pool.back() = -pool.back();
+    }
+  }
+  BigInteger sum;
+  double plain = seconds_per_call(
+      [&] {
+        for (size_t i = 0; i < count; ++i) {
+          sum += pool[i % pool.size()];
+        }
+      },
+      1);
+  BigIntegerAccumulator accumulator;
+  BigInteger accumulated;
+  double deferred = seconds_per_call(
+      [&] {
+        for (size_t i = 0; i < count; ++i) {
+          accumulator += pool[i % pool.size()];
+        }
+        accumulated = accumulator.value();
+      },
+      1);
+  std::cout << "sum " << count << " x " << digits << " digits: += " << plain
+            << " s, accumulator " << deferred << " s"
+            << (sum == accumulated ? "" : " MISMATCH") << std::endl;
+}
+
+// Threads of this process according to /proc, or 0 where it is missing.
+size_t live_threads() {
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  while (status >> key) {
+    if (key == "Threads:") {
+      size_t count = 0;
+      status >> count;
+      return count;
+    }
+  }
+  return 0;
+}
+
+// Most threads alive at once, not counting the sampling thread, while
+// function runs.
+template <typename Function>
+size_t peak_threads(Function function) {
+  std::atomic<bool> done(false);
+  size_t peak = 0;
+  std::thread sampler([&] {
+    while (!done) {
+      peak = std::max(peak, live_threads());
+    }
+  });
+  function();
+  done = true;
+  sampler.join();
+  return peak == 0 ? 0 : peak - 1;
+}
+
+// Times a multiplication of two 20000-limb values and a product of 40000
+// words asked for 8 threads under several concurrency limits, and checks
+// that no more threads than allowed run.
+void benchmark_threads() {
+  BigInteger first = random_number(180000);
+  BigInteger second = random_number(180000);
+  std::vector<uint64_t> words(40000);
+  for (uint64_t& word : words) {
+    word = generator() % 1000000000000000000;
+  }
+  size_t hardware = BigInteger::concurrency();
+  for (size_t limit : {1, 2, 3, 4, 8}) {
+    BigInteger::set_concurrency(limit);
+    double multiply_seconds = 0;
+    size_t multiply_peak = peak_threads([&] {
+      multiply_seconds =
+          seconds_per_call([&] { return first * second; }, 20);
+    });
+    double product_seconds = 0;
+    size_t product_peak = peak_threads([&] {
+      product_seconds = seconds_per_call([&] { return product(words, 8); }, 5);
+    });
+    size_t peak = std::max(multiply_peak, product_peak);
+    std::cout << "concurrency " << limit << ": multiply "
+              << multiply_seconds * 1e3 << " ms, product "
+              << product_seconds * 1e3 << " ms, peak " << peak << " threads"
+              << (peak <= limit ? "" : " (OVER LIMIT)") << std::endl;
+  }
+  BigInteger::set_concurrency(hardware);
+}
+
+// Round trip of count mixed-sign values of 1 to 200 digits through
+// serialize_all and deserialize_all, and rejection of overlong varints,
+// whose tenth byte carries more than the last bit of a 64-bit value.
+void benchmark_serialize(size_t count) {
+  std::vector<BigInteger> values;
+  for (size_t i = 0; i < count; ++i) {
+    values.push_back(random_number(1 + generator() % 200));
+    if (generator() % 2 == 0) {
+      values.back() = -values.back();
+    }
+  }
+  std::vector<uint8_t> bytes;
+  double write = seconds_per_call([&] { bytes = serialize_all(values); }, 1);
+  std::vector<BigInteger> decoded;
+  double read = seconds_per_call(
+      [&] {
+        decoded = deserialize_all<BigIntegerView>(bytes.data(), bytes.size());
+      },
+      1);
+  // A count of 1 and a small-value header, both padded to ten bytes with
+  // bits above 2^64; truncating them would give valid input.
+  std::vector<uint8_t> overlong = {0x81, 0x80, 0x80, 0x80, 0x80,
+                                   0x80, 0x80, 0x80, 0x80, 0x02};
+  size_t accepted = 0;
+  for (uint8_t first_byte : {0x81, 0xfe}) {
+    overlong[0] = first_byte;
+    overlong.push_back(0);
+    try {
+      if (first_byte == 0x81) {
+        deserialize_all<BigIntegerView>(overlong.data(), overlong.size());
+      } else {
+        BigIntegerView(overlong.data(), overlong.size());
+      }
+      ++accepted;
+    } catch (const std::invalid_argument&) {
+    }
+    overlong.pop_back();
+  }
+  std::cout << "serialize " << count << " values (" << bytes.size()
+            << " bytes): write " << write * 1e3 << " ms, read " << read * 1e3
+            << " ms" << (decoded == values ? "" : " MISMATCH")
+            << (accepted == 0 ? "" : " (OVERLONG ACCEPTED)") << std::endl;
+}
+
+// Cubes of roots near 10^6, whose leading limb is small, and random r^e
+// with r < 10^8, each followed by r^e + 1; counts wrong answers.
+void benchmark_perfect_powers(size_t count) {
+  std::vector<BigInteger> powers;
+  for (size_t i = 0; i < count; ++i) {
+    int64_t root = i % 2 == 0
+                       ? 1000000 + static_cast<int64_t>(i / 2)
+                       : 2 + static_cast<int64_t>(generator() % 99999998);
+    powers.push_back(pow(BigInteger(root), i % 2 == 0 ? 3 : 2 + i % 5));
+  }
+  size_t wrong = 0;
+  double seconds = seconds_per_call(
+      [&] {
+        wrong = 0;
+        for (const BigInteger& value : powers) {
+          BigInteger root;
+          uint64_t exponent = 0;
+          if (!is_perfect_power(value, &root, &exponent) ||
+              pow(root, exponent) != value) {
+            ++wrong;
+          }
+          wrong += is_perfect_power(value + 1) ? 1 : 0;
+        }
+      },
+      1);
+  std::cout << "is_perfect_power " << 2 * count << " values: "
+            << seconds / (2 * count) * 1e6 << " us"
+            << (wrong == 0 ? "" : " (" + std::to_string(wrong) + " WRONG)")
+            << std::endl;
+}
+
+// arctan(1 / x) * 10^digits, truncated, from its Taylor series.
+BigInteger arctan_inverse(int64_t x, size_t digits) {
+  BigInteger power = 1;
+  power.decimal_shift(digits);
+  power /= x;
+  BigInteger sum = power;
+  for (int64_t k = 1; !power.is_zero(); ++k) {
+    power /= x * x;
+    if (k % 2 == 1) {
+      sum -= power / (2 * k + 1);
+    } else {
+      sum += power / (2 * k + 1);
+    }
+  }
+  return sum;
+}
+
+// The first `digits` decimal digits of pi by Machin's formula.
+std::string pi_digits(size_t digits) {
+  const size_t guard = 10;
+  BigInteger pi = arctan_inverse(5, digits + guard) * 16 -
+                  arctan_inverse(239, digits + guard) * 4;
+  return pi.toString().substr(0, digits);
+}
+
+// F(n) from [[1, 1], [1, 0]]^n by left-to-right binary powering. Powers of
+// that matrix are symmetric, [[p, q], [q, r]], so a squaring needs three
+// entries and a step by the base matrix none.
+BigInteger fibonacci(uint64_t n) {
+  if (n == 0) {
+    return 0;
+  }
+  BigInteger p = 1;
+  BigInteger q = 1;
+  BigInteger r = 0;
+  for (int bit = 62 - __builtin_clzll(n); bit >= 0; --bit) {
+    BigInteger q_square = q * q;
+    BigInteger next_q = q * (p + r);
+    p = p * p + q_square;
+    r = r * r + q_square;
+    q = std::move(next_q);
+    if ((n >> bit & 1) != 0) {
+      r = q;
+      q = p;
+      p += r;
+    }
+  }
+  return q;
+}
+
+// One scaling series of the JSON report: nanoseconds per operation against
+// a size parameter.
+struct Series {
+  std::string name;
+  std::string parameter;
+  std::vector<std::pair<double, double>> points;
+};
+
+// Repeats function for at least 50 ms and returns nanoseconds per call.
+template <typename Function>
+double ns_per_call(Function function) {
+  size_t repeats = 1;
+  while (true) {
+    double seconds = seconds_per_call(function, repeats);
+    if (seconds * repeats >= 0.05 || repeats >= 100000000) {
+      return seconds * 1e9;
+    }
+    double target = seconds > 0 ? std::min(0.06 / seconds, 1e8) : 2.0 * repeats;
+    repeats = std::max(2 * repeats, static_cast<size_t>(target));
+  }
+}
+
+// Times setup(size)() for every size up to max_size, stopping after the
+// first size that takes more than a second per operation.
+Series measure(const std::string& name, const std::string& parameter,
+               const std::vector<size_t>& sizes, size_t max_size,
+               const std::function<std::function<void()>(size_t)>& setup) {
+  Series series{name, parameter, {}};
+  for (size_t size : sizes) {
+    if (size > max_size) {
+      break;
+    }
+    double ns = ns_per_call(setup(size));
+    series.points.emplace_back(static_cast<double>(size), ns);
+    if (ns > 1e9) {
+      break;
+    }
+  }
+  return series;
+}
+
+// Least-squares fit of ns = coefficient * size^exponent over the points of
+// size >= 100 (all of them if fewer than two qualify), e.g. an exponent near
+// 1 for add and near log2(3) for Karatsuba multiplication.
+std::pair<double, double> power_law_fit(const Series& series) {
+  std::vector<std::pair<double, double>> logs;
+  for (const auto& point : series.points) {
+    if (point.first >= 100) {
+      logs.emplace_back(std::log(point.first), std::log(point.second));
+    }
+  }
+  if (logs.size() < 2) {
+    logs.clear();
+    for (const auto& point : series.points) {
+      logs.emplace_back(std::log(point.first), std::log(point.second));
+    }
+  }
+  if (logs.size() < 2) {
+    return {0.0, logs.empty() ? 0.0 : std::exp(logs[0].second)};
+  }
+  double mean_x = 0;
+  double mean_y = 0;
+  for (const auto& log : logs) {
+    mean_x += log.first / logs.size();
+    mean_y += log.second / logs.size();
+  }
+  double covariance = 0;
+  double variance = 0;
+  for (const auto& log : logs) {
+    covariance += (log.first - mean_x) * (log.second - mean_y);
+    variance += (log.first - mean_x) * (log.first - mean_x);
+  }
+  double exponent = covariance / variance;
+  return {exponent, std::exp(mean_y - exponent * mean_x)};
+}
+
+void print_json(const std::vector<Series>& report) {
+  std::cout << "{\n  \"benchmarks\": [";
+  for (size_t i = 0; i < report.size(); ++i) {
+    const Series& series = report[i];
+    std::pair<double, double> fit = power_law_fit(series);
+    std::cout << (i == 0 ? "" : ",") << "\n    {\"name\": \"" << series.name
+              << "\", \"parameter\": \"" << series.parameter
+              << "\", \"exponent\": " << fit.first
+              << ", \"coefficient_ns\": " << fit.second << ", \"points\": [";
+    for (size_t j = 0; j < series.points.size(); ++j) {
+      std::cout << (j == 0 ? "" : ", ") << "{\"size\": "
+                << static_cast<size_t>(series.points[j].first)
+                << ", \"ns_per_op\": " << series.points[j].second << "}";
+    }
+    std::cout << "]}";
+  }
+  std::cout << "\n  ]\n}" << std::endl;
+}
+
+// Every operator on operands of 10 to max_limbs limbs (division and
+// remainder on 2n / n limbs), then whole workloads, as a JSON report.
+void benchmark_suite(size_t max_limbs) {
+  std::vector<size_t> limbs;
+  for (int half_decades = 2; half_decades <= 12; ++half_decades) {
+    limbs.push_back(static_cast<size_t>(
+        std::round(std::pow(10.0, half_decades / 2.0))));
+  }
+  auto binary = [](std::function<void(const BigInteger&, const BigInteger&)>
+                       operation,
+                   size_t first_factor) {
+    return [operation, first_factor](size_t size) -> std::function<void()> {
+      auto first = std::make_shared<BigInteger>(
+          random_number(9 * first_factor * size));
+      auto second = std::make_shared<BigInteger>(random_number(9 * size));
+      return [operation, first, second] { operation(*first, *second); };
+    };
+  };
+  BigInteger sink;
+  std::vector<Series> report;
+  report.push_back(measure(
+      "add", "limbs", limbs, max_limbs,
+      binary([&](const BigInteger& a, const BigInteger& b) { sink = a + b; },
+             1)));
+  report.push_back(measure(
+      "sub", "limbs", limbs, max_limbs,
+      binary([&](const BigInteger& a, const BigInteger& b) { sink = a - b; },
+             1)));
+  report.push_back(measure(
+      "mul", "limbs", limbs, max_limbs,
+      binary([&](const BigInteger& a, const BigInteger& b) { sink = a * b; },
+             1)));
+  report.push_back(measure(
+      "div", "limbs", limbs, max_limbs,
+      binary([&](const BigInteger& a, const BigInteger& b) { sink = a / b; },
+             2)));
+  report.push_back(measure(
+      "mod", "limbs", limbs, max_limbs,
+      binary([&](const BigInteger& a, const BigInteger& b) { sink = a % b; },
+             2)));
+  report.push_back(measure(
+      "gcd", "limbs", limbs, max_limbs,
+      binary([&](const BigInteger& a,
+                 const BigInteger& b) { sink = gcd(a, b); },
+             1)));
+  std::string text;
+  report.push_back(measure(
+      "toString", "limbs", limbs, max_limbs,
+      binary([&](const BigInteger& a,
+                 const BigInteger&) { text = a.toString(); },
+             1)));
+  report.push_back(measure(
+      "parse", "limbs", limbs, max_limbs,
+      [&](size_t size) -> std::function<void()> {
+        auto digits = std::make_shared<std::string>(
+            random_number(9 * size).toString());
+        return [&sink, digits] { sink = BigInteger(*digits); };
+      }));
+  report.push_back(measure(
+      "asDecimal", "limbs", limbs, max_limbs,
+      [&](size_t size) -> std::function<void()> {
+        auto value = std::make_shared<Rational>(random_number(9 * size),
+                                                random_number(9 * size));
+        return [&text, value, size] {
+          Rational copy = *value;
+          text = copy.asDecimal(9 * size);
+        };
+      }));
+  std::vector<size_t> counts;
+  for (size_t count = 100; count <= 10000000; count *= 10) {
+    counts.push_back(count);
+  }
+  report.push_back(measure("factorial", "n", counts, max_limbs * 10,
+                           [&](size_t n) -> std::function<void()> {
+                             return [&sink, n] { sink = factorial(n); };
+                           }));
+  report.push_back(measure("fibonacci", "n", counts, max_limbs * 100,
+                           [&](size_t n) -> std::function<void()> {
+                             return [&sink, n] { sink = fibonacci(n); };
+                           }));
+  report.push_back(measure("pi", "digits", counts, max_limbs * 9,
+                           [&](size_t digits) -> std::function<void()> {
+                             return [&text, digits] {
+                               text = pi_digits(digits);
+                             };
+                           }));
+  print_json(report);
+}
+
+int main(int argc, char** argv) {
+  std::string mode = argc > 1 ? argv[1] : "suite";
+  if (mode == "suite" || mode == "quick") {
+    benchmark_suite(mode == "quick" ? 1000 : 1000000);
+  } else if (mode == "kernels") {
+    for (size_t limbs : {16, 64, 256, 1024, 4096, 16384, 65536, 262144,
+                         1000000}) {
+      benchmark_limb_kernels(limbs);
+    }
+  } else if (mode == "modpow") {
+    for (size_t bits : {2048, 4096, 8192}) {
+      benchmark_modpow(bits);
+    }
+  } else if (mode == "sort") {
+    benchmark_sort(10000000);
+  } else if (mode == "sum") {
+    for (size_t digits : {20, 200, 2000}) {
+      benchmark_sum(10000000, digits);
+    }
+  } else if (mode == "powers") {
+    benchmark_perfect_powers(20000);
+  } else if (mode == "threads") {
+    benchmark_threads();
+  } else if (mode == "serialize") {
+    benchmark_serialize(1000000);
+  } else {
+    std::cerr << "usage: " << argv[0]
+              << " [suite|quick|kernels|modpow|sort|sum|powers|threads|"
+                 "serialize]"
+              << std::endl;
+    return 1;
+  }
+}
@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <string>
@@ -607,7 +608,7 @@ class Rational {
       return numerator_.toString() + '/' + denominator_.toString();
     }
   }
-  std::string asи(size_t precision = 0) const {
+  std::string asDecimal(size_t precision = 0) const {
     BigInteger tmp;
     BigInteger new_numerator;
     if (numerator_.is_negative()) {
@@ -681,9 +682,10 @@ class Rational {
   }
 };
 
+// Both sides are kept in lowest terms with a positive denominator.
 bool operator==(const Rational& first, const Rational& other) {
-  return first.numerator_ * other.denominator_ ==
-         other.numerator_ * first.denominator_;
+  return first.denominator_ == other.denominator_ &&
+         first.numerator_ == other.numerator_;
 }
 bool operator!=(const Rational& first, const Rational& other) {
   return !(first == other);
@@ -695,6 +697,23 @@ bool operator<(const Rational& first, const Rational& other) {
   if (!first.numerator_.is_negative() && other.numerator_.is_negative()) {
     return false;
   }
+  if (first.denominator_ == other.denominator_) {
+    return first.numerator_ < other.numerator_;
+  }
+  if (first.numerator_ == other.numerator_) {
+    return first.numerator_.is_negative()
+               ? first.denominator_ < other.denominator_
+               : other.denominator_ < first.denominator_;
+  }
+  if (first.numerator_ == 0 || other.numerator_ == 0) {
+    return first.numerator_ == 0;
+  }
+  // A product of x and y limbs has x + y - 1 or x + y limbs.
+  size_t left = first.numerator_.size() + other.denominator_.size();
+  size_t right = other.numerator_.size() + first.denominator_.size();
+  if (left + 1 < right || right + 1 < left) {
+    return (left < right) != first.numerator_.is_negative();
+  }
   return first.numerator_ * other.denominator_ <
          other.numerator_ * first.denominator_;
 }
@@ -748,30 +767,124 @@ std::istream& operator>>(std::istream& in, Rational& value) {
   return in;
 }
 
-template <size_t N, size_t mod, bool Stop = ((mod * mod) > N)>
-struct prime_recursion {
-  static const bool value =
-      (N % mod != 0) && (Stop ? true : prime_recursion<N, mod + 1>::value);
-};
+constexpr uint64_t multiply_mod(uint64_t first, uint64_t second,
+                                uint64_t modulus) {
+  return static_cast<uint64_t>(static_cast<unsigned __int128>(first) *
+                               second % modulus);
+}
 
-template <size_t N, size_t mod>
-struct prime_recursion<N, mod, true> {
-  static const bool value = true;
-};
+constexpr uint64_t power_mod(uint64_t base, uint64_t exponent,
+                             uint64_t modulus) {
+  uint64_t result = 1;
+  for (; exponent != 0; exponent /= 2) {
+    if (exponent % 2 == 1) {
+      result = multiply_mod(result, base, modulus);
+    }
+    base = multiply_mod(base, base, modulus);
+  }
+  return result;
+}
 
-template <size_t N, bool flag>
-struct prime_recursion<N, 1, flag> {
-  static const bool value = flag;
-};
+// Deterministic Miller-Rabin: the first twelve primes as bases decide every
+// n < 2^64, so prime_check costs a few hundred constexpr steps for any N.
+constexpr bool miller_rabin_prime(uint64_t n) {
+  const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+  if (n < 2) {
+    return false;
+  }
+  for (uint64_t base : bases) {
+    if (n % base == 0) {
+      return n == base;
+    }
+  }
+  uint64_t odd_part = n - 1;
+  int twos = 0;
+  while (odd_part % 2 == 0) {
+    odd_part /= 2;
+    ++twos;
+  }
+  for (uint64_t base : bases) {
+    uint64_t x = power_mod(base, odd_part, n);
+    if (x == 1 || x == n - 1) {
+      continue;
+    }
+    bool witness = true;
+    for (int i = 1; i < twos && witness; ++i) {
+      x = multiply_mod(x, x, n);
+      witness = x != n - 1;
+    }
+    if (witness) {
+      return false;
+    }
+  }
+  return true;
+}
 
 template <size_t N>
 struct prime_check {
-  static const bool value = prime_recursion<N, 2>::value;
+  static const bool value = miller_rabin_prime(N);
 };
 
-template <>
-struct prime_check<1> {
-  static const bool value = false;
+// Modular arithmetic on canonical values in [0, N), with the reduction
+// chosen at compile time: Barrett with a 64-bit reciprocal while products
+// fit 64 bits (N < 2^32), Montgomery with 128-bit products for larger odd N,
+// and a 128-bit remainder otherwise. Sums and differences use one
+// conditional subtraction or addition, done with a mask.
+template <size_t N>
+struct ResidueArithmetic {
+  static_assert(N >= 1 && N <= static_cast<size_t>(INT64_MAX),
+                "Residue modulus must fit int64_t");
+  using u128 = unsigned __int128;
+  static constexpr bool kBarrett = N < (uint64_t(1) << 32);
+  static constexpr bool kMontgomery = !kBarrett && N % 2 == 1;
+  // floor(2^64 / N); for N = 1 any value works, the result is always 0.
+  static constexpr uint64_t kReciprocal =
+      N == 1 ? 0 : static_cast<uint64_t>((u128(1) << 64) / N);
+  static constexpr uint64_t inverse() {
+    uint64_t inverse = N;  // N * N == 1 mod 8 for odd N
+    for (int i = 0; i < 5; ++i) {
+      inverse *= 2 - N * inverse;
+    }
+    return 0 - inverse;
+  }
+  // -N^-1 mod 2^64 and R^2 mod N for R = 2^64.
+  static constexpr uint64_t kNegativeInverse = kMontgomery ? inverse() : 0;
+  static constexpr uint64_t kRSquared = static_cast<uint64_t>(
+      (((u128(1) << 64) % N) * ((u128(1) << 64) % N)) % N);
+
+  static uint64_t add(uint64_t first, uint64_t second) {
+    uint64_t sum = first + second;
+    uint64_t reduced = sum - N;
+    uint64_t mask = 0 - static_cast<uint64_t>(sum < N);
+    return reduced + (mask & N);
+  }
+  static uint64_t subtract(uint64_t first, uint64_t second) {
+    uint64_t difference = first - second;
+    uint64_t mask = 0 - static_cast<uint64_t>(first < second);
+    return difference + (mask & N);
+  }
+  // value * R^-1 mod N for value < N * R.
+  static uint64_t redc(u128 value) {
+    uint64_t factor = static_cast<uint64_t>(value) * kNegativeInverse;
+    uint64_t result =
+        static_cast<uint64_t>((value + static_cast<u128>(factor) * N) >> 64);
+    return result >= N ? result - N : result;
+  }
+  static uint64_t multiply(uint64_t first, uint64_t second) {
+    if constexpr (kBarrett) {
+      uint64_t product = first * second;
+      uint64_t quotient =
+          static_cast<uint64_t>((static_cast<u128>(product) * kReciprocal) >>
+                                64);
+      uint64_t result = product - quotient * N;
+      return result >= N ? result - N : result;
+    } else if constexpr (kMontgomery) {
+      uint64_t scaled = redc(static_cast<u128>(second) * kRSquared);
+      return redc(static_cast<u128>(first) * scaled);
+    } else {
+      return static_cast<uint64_t>(static_cast<u128>(first) * second % N);
+    }
+  }
 };
 
 template <size_t N, bool flag = prime_check<N>::value>
@@ -780,7 +893,7 @@ struct Residue {
   int64_t value_;
   Residue(int64_t value = 0) {
     if (value >= 0) {
-      value_ = value % N;
+      value_ = value % static_cast<int64_t>(N);
     } else {
       value_ = (static_cast<int64_t>(N) + value % static_cast<int64_t>(N)) %
                static_cast<int64_t>(N);
@@ -797,7 +910,7 @@ struct Residue {
   explicit operator int() const { return static_cast<int>(value_); }
   void Reduce() {
     if (value_ >= 0) {
-      value_ = value_ % N;
+      value_ = value_ % static_cast<int64_t>(N);
     } else {
       value_ = (static_cast<int64_t>(N) + value_ % static_cast<int64_t>(N)) %
                static_cast<int64_t>(N);
@@ -822,58 +935,116 @@ bool operator<(const Residue<N>& first, const Residue<N>& second) {
   return first.value_ < second.value_;
 }
 template <size_t N>
-Residue<N> operator+(const Residue<N>& first, const Residue<N>& second) {
-  return Residue<N>(first.value_ + second.value_);
-}
-template <size_t N>
 Residue<N>& operator+=(Residue<N>& first, const Residue<N>& second) {
-  first.value_ += second.value_;
-  first.Reduce();
+  first.value_ = ResidueArithmetic<N>::add(first.value_, second.value_);
   return first;
 }
 template <size_t N>
-Residue<N> operator-(const Residue<N>& first, const Residue<N>& second) {
-  return Residue<N>(first.value_ - second.value_);
+Residue<N> operator+(const Residue<N>& first, const Residue<N>& second) {
+  Residue<N> result(first);
+  return result += second;
 }
 template <size_t N>
 Residue<N>& operator-=(Residue<N>& first, const Residue<N>& second) {
-  first.value_ -= second.value_;
-  first.Reduce();
+  first.value_ = ResidueArithmetic<N>::subtract(first.value_, second.value_);
   return first;
 }
 template <size_t N>
-Residue<N> operator*(const Residue<N>& first, const Residue<N>& second) {
-  return Residue<N>(first.value_ * second.value_);
+Residue<N> operator-(const Residue<N>& first, const Residue<N>& second) {
+  Residue<N> result(first);
+  return result -= second;
 }
 template <size_t N>
 Residue<N>& operator*=(Residue<N>& first, const Residue<N>& second) {
-  first.value_ *= second.value_;
-  first.Reduce();
+  first.value_ = ResidueArithmetic<N>::multiply(first.value_, second.value_);
   return first;
 }
+template <size_t N>
+Residue<N> operator*(const Residue<N>& first, const Residue<N>& second) {
+  Residue<N> result(first);
+  return result *= second;
+}
 
 template <size_t N>
 Residue<N, true> binary_power(Residue<N, true> value, size_t power) {
-  int64_t result = 1;
-  int64_t val = value.value_;
+  Residue<N, true> result = 1;
   while (power != 0) {
     if (power % 2 == 1) {
-      result = (result * val) % N;
+      result *= value;
     }
-    val = (val * val) % N;
+    value *= value;
     power /= 2;
   }
-  return Residue<N, true>(result);
+  return result;
 }
+// Binary extended Euclid on (value, N): only shifts and subtractions, with
+// the invariants u == x1 * value and v == x2 * value mod N. Zero has no
+// inverse and maps to zero.
 template <size_t N>
 Residue<N, true> inversed_element(const Residue<N, true>& value) {
-  return binary_power(value, N - 2);
+  if (N == 2 || value.value_ <= 1) {
+    return value;
+  }
+  uint64_t u = value.value_;
+  uint64_t v = N;
+  uint64_t x1 = 1;
+  uint64_t x2 = 0;
+  auto halve = [](uint64_t x) { return (x % 2 == 0 ? x : x + N) / 2; };
+  while (u != 1 && v != 1) {
+    while (u % 2 == 0) {
+      u /= 2;
+      x1 = halve(x1);
+    }
+    while (v % 2 == 0) {
+      v /= 2;
+      x2 = halve(x2);
+    }
+    if (u >= v) {
+      u -= v;
+      x1 = ResidueArithmetic<N>::subtract(x1, x2);
+    } else {
+      v -= u;
+      x2 = ResidueArithmetic<N>::subtract(x2, x1);
+    }
+  }
+  Residue<N, true> result;
+  result.value_ = u == 1 ? x1 : x2;
+  return result;
 }
 Rational inversed_element(const Rational& value) {
   return Rational(value.denominator_, value.numerator_);
 }
 long double inversed_element(long double value) { return 1 / (value); }
 double inversed_element(double value) { return 1 / (value); }
+// Replaces every nonzero element of values[0, count) by its inverse.
+template <typename Field>
+void batch_inverse(Field* values, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    if (values[i] != Field(0)) {
+      values[i] = inversed_element(values[i]);
+    }
+  }
+}
+// Montgomery's trick: prefix products, a single inversion of the total,
+// then the inverses peeled off backwards, for three multiplications each.
+template <size_t N>
+void batch_inverse(Residue<N, true>* values, size_t count) {
+  std::vector<Residue<N, true>> prefix(count + 1, 1);
+  for (size_t i = 0; i < count; ++i) {
+    prefix[i + 1] = prefix[i];
+    if (values[i] != Residue<N, true>(0)) {
+      prefix[i + 1] *= values[i];
+    }
+  }
+  Residue<N, true> inverse = inversed_element(prefix[count]);
+  for (size_t i = count; i != 0; --i) {
+    if (values[i - 1] != Residue<N, true>(0)) {
+      Residue<N, true> element = values[i - 1];
+      values[i - 1] = inverse * prefix[i - 1];
+      inverse *= element;
+    }
+  }
+}
 template <size_t N>
 Residue<N, true> operator/(const Residue<N, true>& first,
                            const Residue<N, true>& second) {
@@ -1007,9 +1178,10 @@ struct Matrix {
         break;
       }
       std::swap(copy.values_[row], copy.values_[max_index]);
+      Field pivot_inverse = inversed_element(copy.values_[row][column]);
       Field inv = 0;
       for (size_t i = row + 1; i < M; ++i) {
-        inv = copy.values_[i][column] / copy.values_[row][column];
+        inv = copy.values_[i][column] * pivot_inverse;
         for (size_t j = column; j < N; ++j) {
           copy.values_[i][j] -= inv * copy.values_[row][j];
         }
@@ -1139,9 +1311,10 @@ struct Matrix<N, N, Field> {
         std::swap(copy.values_[row], copy.values_[max_index]);
       }
       determinant *= copy.values_[row][row];
+      Field pivot_inverse = inversed_element(copy.values_[row][row]);
       Field inv = 0;
       for (size_t i = row + 1; i < N; ++i) {
-        inv = copy.values_[i][row] / copy.values_[row][row];
+        inv = copy.values_[i][row] * pivot_inverse;
         for (size_t j = row; j < N; ++j) {
           copy.values_[i][j] -= inv * copy.values_[row][j];
         }
@@ -1162,6 +1335,7 @@ struct Matrix<N, N, Field> {
       }
       bigMatrix.values_[i][N + i] = 1;
     }
+    std::array<Field, N> diagonal_inverses;
     for (size_t row = 0; row < N; ++row) {
       Field max(bigMatrix.values_[row][row]);
       size_t max_index = row;
@@ -1172,14 +1346,16 @@ struct Matrix<N, N, Field> {
         }
       }
       std::swap(bigMatrix.values_[row], bigMatrix.values_[max_index]);
+      Field pivot_inverse = inversed_element(bigMatrix.values_[row][row]);
+      diagonal_inverses[row] = pivot_inverse;
       for (size_t i = row + 1; i < N; ++i) {
-        Field inv = bigMatrix.values_[i][row] / bigMatrix.values_[row][row];
+        Field inv = bigMatrix.values_[i][row] * pivot_inverse;
         for (size_t j = row; j < 2 * N; ++j) {
           bigMatrix.values_[i][j] -= inv * bigMatrix.values_[row][j];
         }
       }
       for (size_t i = 0; i < row; ++i) {
-        Field inv = bigMatrix.values_[i][row] / bigMatrix.values_[row][row];
+        Field inv = bigMatrix.values_[i][row] * pivot_inverse;
         for (size_t j = row; j < N * 2; ++j) {
           bigMatrix.values_[i][j] -= inv * bigMatrix.values_[row][j];
         }
@@ -1189,7 +1365,7 @@ struct Matrix<N, N, Field> {
     for (size_t i = 0; i < N; ++i) {
       for (size_t j = 0; j < N; ++j) {
         Result.values_[i][j] =
-            bigMatrix.values_[i][N + j] / bigMatrix.values_[i][i];
+            bigMatrix.values_[i][N + j] * diagonal_inverses[i];
       }
     }
     return Result;
@@ -1229,9 +1405,10 @@ struct Matrix<N, N, Field> {
         break;
       }
       std::swap(copy.values_[row], copy.values_[max_index]);
+      Field pivot_inverse = inversed_element(copy.values_[row][column]);
       Field inv = 0;
       for (size_t i = row + 1; i < N; ++i) {
-        inv = copy.values_[i][column] / copy.values_[row][column];
+        inv = copy.values_[i][column] * pivot_inverse;
         for (size_t j = column; j < N; ++j) {
           copy.values_[i][j] -= inv * copy.values_[row][j];
         }